@@ -10,6 +10,7 @@ void play_audio(const char *const url)
 {
 	av::MediaReader format{url};
 	const auto stream = format.find_best_stream(AVMEDIA_TYPE_AUDIO);
+	format.select_stream(stream->index);
 	auto decoder = stream.create_decoder();
 	decoder.open();
 
@@ -113,6 +113,12 @@ public:
 
 	void operator<<(AVFrame *frame) { src.add_frame(frame); }
 	void operator>>(AVFrame *frame) { sink.get_frame(frame); }
+
+	// `AVERROR(EAGAIN)` and `AVERROR_EOF` are expected here, so don't throw
+	av::Expected<void> try_receive(AVFrame *frame)
+	{
+		return sink.try_get_frame(frame);
+	}
 };
 
 void process_output(AVMD5 *md5, av::Frame &frame)
@@ -198,34 +204,23 @@ int main(int argc, char *argv[])
 			pipeline << frame;
 
 			// Get all filtered output that is available
-			while (true)
+			av::Expected<void> rc;
+			while ((rc = pipeline.try_receive(frame)))
+			{
+				process_output(md5, frame);
+				frame.unref();
+			}
+
+			if (rc.error() == AVERROR_EOF)
 			{
-				try
-				{
-					pipeline >> frame;
-					process_output(md5, frame);
-					frame.unref();
-				}
-				catch (const av::Error &e)
-				{
-					if (e.errnum == AVERROR(EAGAIN))
-					{
-						// Need to feed more frames
-						break;
-					}
-					else if (e.errnum == AVERROR_EOF)
-					{
-						// No more output
-						av_freep(&md5);
-						return 0;
-					}
-					else
-					{
-						// An error occurred
-						throw;
-					}
-				}
+				// No more output
+				av_freep(&md5);
+				return 0;
 			}
+			if (rc.error() != AVERROR(EAGAIN))
+				// An error occurred
+				throw av::Error("av_buffersink_get_frame", rc.error());
+			// Otherwise, need to feed more frames
 		}
 
 		av_freep(&md5);
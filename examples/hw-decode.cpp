@@ -66,6 +66,7 @@ void hw_decode(
 	const AVCodec *decoder = nullptr;
 	const auto video_stream =
 		ifmt.find_best_stream(AVMEDIA_TYPE_VIDEO, -1, -1, &decoder);
+	ifmt.select_stream(video_stream->index);
 
 	auto hw_pix_fmt = find_hw_pix_fmt(decoder, dev_type);
 
@@ -0,0 +1,52 @@
+// stream-copy remux between containers, reporting throughput
+
+#include <av/MediaReader.hpp>
+#include <av/MediaWriter.hpp>
+#include <av/Remuxer.hpp>
+
+#include <chrono>
+#include <iostream>
+
+void remux(const char *const inpath, const char *const outpath)
+{
+	av::MediaReader ifmt{inpath};
+	av::MediaWriter ofmt{outpath};
+	av::Remuxer remuxer{ifmt, ofmt};
+
+	const auto start = std::chrono::steady_clock::now();
+	const auto stats = remuxer.run();
+	const std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	const auto in_bytes = ifmt->pb ? avio_size(ifmt->pb) : -1;
+	std::cout << stats.packets << " packets, " << stats.bytes / 1e6
+			  << " MB of payload in " << elapsed.count() << " s";
+	if (in_bytes > 0)
+		std::cout << " (" << in_bytes / 1e6 / elapsed.count()
+				  << " MB/s of input)";
+	std::cout << '\n';
+}
+
+int main(const int argc, const char *const *const argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: " << argv[0]
+				  << " <input file> <output file>\n"
+					 "The output format is guessed according to the file "
+					 "extension.\n";
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		remux(argv[1], argv[2]);
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << "Error: " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -1,18 +1,23 @@
 // translation of ffmpeg's vaapi_transcode.c to libavpp
 
 #include "av/Util.hpp"
+#include <av/AsyncEncoder.hpp>
 #include <av/HWDeviceContext.hpp>
 #include <av/HWFramesContext.hpp>
 #include <av/MediaReader.hpp>
 #include <av/MediaWriter.hpp>
 
 #include <iostream>
+#include <optional>
 
 void transcode(
 	const char *const inpath,
 	const char *const outpath,
 	const char *const enc_codec_name)
 {
+	// frames queued for the encoder thread hold on to decoder surfaces
+	const av::AsyncEncoder::Limits limits{.max_frames = 4};
+
 	av::HWDeviceContext hwdctx{AV_HWDEVICE_TYPE_VAAPI};
 	av::MediaReader ifmt{inpath};
 	const auto video_stream = ifmt.find_best_stream(AVMEDIA_TYPE_VIDEO);
@@ -28,13 +33,15 @@ void transcode(
 					 "using VA-API\n";
 		return AV_PIX_FMT_NONE;
 	};
+	decoder_ctx->extra_hw_frames = limits.max_frames;
 	decoder_ctx.open();
 
 	av::MediaWriter ofmt{outpath};
 	const auto encoder = av::find_encoder_by_name(enc_codec_name);
 	av::Encoder encoder_ctx{encoder};
 	av::Stream ost{nullptr};
-	bool initialized{};
+	// encodes and muxes on its own thread while we keep decoding
+	std::optional<av::AsyncEncoder> async_encoder;
 
 	while (const auto pkt = ifmt.read_packet())
 	{
@@ -47,7 +54,7 @@ void transcode(
 		decoder_ctx.send_packet(pkt);
 		while (const auto frm = decoder_ctx.receive_frame())
 		{
-			if (!initialized)
+			if (!async_encoder)
 			{
 				// set AVCodecContext Parameters for encoder
 				if (!(encoder_ctx->hw_frames_ctx =
@@ -65,28 +72,25 @@ void transcode(
 				ost->time_base = encoder_ctx->time_base;
 
 				ofmt.write_header();
-				initialized = true;
+				async_encoder.emplace(
+					encoder_ctx,
+					limits,
+					[&](AVPacket *const enc_pkt)
+					{
+						enc_pkt->stream_index = ost->index;
+						av_packet_rescale_ts(
+							enc_pkt, video_stream->time_base, ost->time_base);
+						ofmt.write_packet(enc_pkt);
+					});
 			}
 
-			encoder_ctx.send_frame(frm);
-			while (const auto enc_pkt = encoder_ctx.receive_packet())
-			{
-				enc_pkt->stream_index = ost->index;
-				av_packet_rescale_ts(
-					enc_pkt, video_stream->time_base, ost->time_base);
-				ofmt.write_packet(enc_pkt);
-			}
+			async_encoder->send_frame(frm);
 		}
 	}
 
 	// flush encoder
-	encoder_ctx.send_frame(nullptr);
-	while (const auto enc_pkt = encoder_ctx.receive_packet())
-	{
-		enc_pkt->stream_index = ost->index;
-		av_packet_rescale_ts(enc_pkt, video_stream->time_base, ost->time_base);
-		ofmt.write_packet(enc_pkt);
-	}
+	if (async_encoder)
+		async_encoder->flush();
 
 	ofmt.write_trailer();
 }
@@ -7,51 +7,28 @@
 
 #include <av/Frame.hpp>
 #include <av/MediaReader.hpp>
+#include <av/PlaneView.hpp>
+#include <av/PrefetchReader.hpp>
 #include <av/Scaler.hpp>
 
-// Copies a padded frame to a tightly-packed buffer and updates the texture.
-void update_texture_from_padded_frame(
-	sf::Texture &texture, const AVFrame *const frame, const sf::Vector2u &size)
+// Updates the texture from an RGBA frame, first copying it to a
+// tightly-packed buffer if its rows are padded.
+void update_texture_from_frame(sf::Texture &texture, const AVFrame *const frame)
 {
-	const int linesize = frame->linesize[0];
-	const int width_bytes = size.x * 4; // 4 bytes for RGBA
+	const auto view = av::plane_view<AV_PIX_FMT_RGBA, 0>(frame);
 
-	static std::vector<uint8_t> pixel_buffer;
-	pixel_buffer.resize(width_bytes * size.y);
-
-	const uint8_t *src_pixels = frame->data[0];
-	uint8_t *dst_pixels = pixel_buffer.data();
-
-	for (unsigned i = 0; i < size.y; ++i)
-	{
-		// Copy one line of pixels
-		memcpy(dst_pixels, src_pixels, width_bytes);
-		// Move pointers to the start of the next line
-		dst_pixels += width_bytes; // Tightly packed destination
-		src_pixels += linesize;	   // Padded source
-	}
-	texture.update(pixel_buffer.data());
-}
-
-// Handles potential stride/linesize issues by copying frame data line-by-line
-// if padding is present.
-void update_texture_from_frame(
-	sf::Texture &texture, const AVFrame *const frame, const sf::Vector2u &size)
-{
-	// Check if the frame has padding
-	const int linesize = frame->linesize[0];
-	const int width_bytes = size.x * 4; // 4 bytes for RGBA
-
-	if (linesize == width_bytes)
+	if (view.contiguous())
 	{
 		// No padding, we can update directly
-		texture.update(frame->data[0]);
-	}
-	else
-	{
-		// Padding exists, copy line by line
-		update_texture_from_padded_frame(texture, frame, size);
+		texture.update(reinterpret_cast<const uint8_t *>(view.data()));
+		return;
 	}
+
+	// Padding exists, copy line by line
+	static std::vector<av::PixelRGBA> pixel_buffer;
+	pixel_buffer.resize(view.width() * view.height());
+	view.copy_to(pixel_buffer);
+	texture.update(reinterpret_cast<const uint8_t *>(pixel_buffer.data()));
 }
 
 void play_video(const char *const url)
@@ -65,6 +42,7 @@ void play_video(const char *const url)
 	auto vdecoder = vstream.create_decoder();
 	auto adecoder = astream.create_decoder();
 
+	vdecoder.set_threading(av::CodecContext::Threading::AUTO);
 	vdecoder.open();
 	adecoder.open();
 
@@ -92,7 +70,10 @@ void play_video(const char *const url)
 	sf::Texture texture{size};
 	sf::Sprite sprite{texture};
 
-	while (const auto packet = format.read_packet())
+	// demux on a background thread so slow reads don't stall rendering
+	av::PrefetchReader reader{format};
+
+	while (const auto packet = reader.read_packet())
 	{
 		if (!window.isOpen())
 			break;
@@ -107,7 +88,7 @@ void play_video(const char *const url)
 			while (const auto frame = vdecoder.receive_frame())
 			{
 				scaler.scale_frame(scaled_frame, frame);
-				update_texture_from_frame(texture, scaled_frame, size);
+				update_texture_from_frame(texture, scaled_frame);
 				window.draw(sprite);
 				window.display();
 			}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+
+#include "BoundedQueue.hpp"
+#include "Encoder.hpp"
+#include "Error.hpp"
+#include "Frame.hpp"
+#include "Packet.hpp"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace av
+{
+
+/**
+ * Runs an opened `Encoder` on a dedicated thread, so decoding and filtering on
+ * the calling thread overlap with encoding. Frames are passed in by reference
+ * through a bounded queue; encoded packets come out through a second bounded
+ * queue (`receive_packet()`) or a callback invoked on the encoder thread.
+ * @warning Do not use the `Encoder` directly while an `AsyncEncoder` exists.
+ */
+class AsyncEncoder
+{
+public:
+	struct Limits
+	{
+		// frames queued ahead of the encoder
+		size_t max_frames = 8;
+		// encoded packets waiting for `receive_packet()`
+		size_t max_packets = 64;
+	};
+
+	/**
+	 * Called on the encoder thread for every encoded packet. May move the
+	 * packet's reference out, e.g. with `MediaWriter::write_packet`.
+	 */
+	using Callback = std::function<void(AVPacket *)>;
+
+private:
+	Encoder &_encoder;
+	const Callback _callback;
+	PacketPool _pool;
+	BoundedQueue<OwnedFrame> _frames;
+	BoundedQueue<OwnedPacket> _packets;
+	OwnedPacket _pkt{nullptr};
+	std::exception_ptr _error;
+	std::atomic<bool> _abort{};
+	std::thread _thread;
+
+public:
+	/**
+	 * Start the encoder thread.
+	 * @param encoder An opened encoder. Must outlive this object.
+	 * @param callback If set, receives the encoded packets instead of
+	 * `receive_packet()`.
+	 */
+	AsyncEncoder(Encoder &encoder, const Limits &limits, Callback callback)
+		: _encoder{encoder},
+		  _callback{std::move(callback)},
+		  _pool{limits.max_packets + 1},
+		  _frames{limits.max_frames},
+		  _packets{limits.max_packets},
+		  _thread{&AsyncEncoder::run, this}
+	{
+	}
+
+	AsyncEncoder(Encoder &encoder, const Limits &limits)
+		: AsyncEncoder{encoder, limits, {}}
+	{
+	}
+
+	AsyncEncoder(Encoder &encoder)
+		: AsyncEncoder{encoder, Limits{}, {}}
+	{
+	}
+
+	/**
+	 * Abandon any frames not yet encoded and stop the encoder thread. Call
+	 * `flush()` first to encode everything.
+	 */
+	~AsyncEncoder()
+	{
+		_abort = true;
+		_frames.close();
+		_packets.close();
+		if (_thread.joinable())
+			_thread.join();
+	}
+
+	AsyncEncoder(const AsyncEncoder &) = delete;
+	AsyncEncoder &operator=(const AsyncEncoder &) = delete;
+
+	/**
+	 * Queue a new reference to `frame` for encoding, blocking while the queue
+	 * is full. The frame's data is not copied.
+	 * @param frame `NULL` signals the end of the stream, like `flush()`
+	 * without waiting.
+	 * @return `false` if the end of the stream was already signaled.
+	 * @throws `av::Error` (or any other exception) raised on the encoder thread
+	 */
+	bool send_frame(const AVFrame *const frame)
+	{
+		if (!frame)
+		{
+			_frames.close();
+			return true;
+		}
+		OwnedFrame ref;
+		if (const auto rc = av_frame_ref(ref, frame); rc < 0)
+			throw Error("av_frame_ref", rc);
+		return send_frame(std::move(ref));
+	}
+
+	/**
+	 * Queue `frame` for encoding, taking it over without adding a reference.
+	 */
+	bool send_frame(OwnedFrame &&frame)
+	{
+		check_error();
+		if (_frames.push(std::move(frame)))
+			return true;
+		check_error();
+		return false;
+	}
+
+	/**
+	 * Receive an encoded packet, blocking until one is available. Only
+	 * available without a callback.
+	 * @warning Blocks while the encoder needs more frames (e.g. during
+	 * lookahead), so a blocking consumer must run on its own thread, apart
+	 * from the one calling `send_frame()`. A single thread must use
+	 * `try_receive_packet()` instead.
+	 * @return A pointer to the current packet, valid until the next call, or
+	 * `NULL` once the encoder has been fully flushed.
+	 * @throws `av::Error` (or any other exception) raised on the encoder thread
+	 */
+	AVPacket *receive_packet()
+	{
+		auto pkt = _packets.pop();
+		if (!pkt)
+		{
+			check_error();
+			return NULL;
+		}
+		_pkt = std::move(*pkt);
+		return _pkt;
+	}
+
+	/**
+	 * Non-blocking `receive_packet()`, for a single thread that both sends
+	 * frames and receives packets.
+	 * @return A pointer to the current packet, valid until the next call, or
+	 * `AVERROR(EAGAIN)` if none is ready yet, or `AVERROR_EOF` once the
+	 * encoder has been fully flushed.
+	 * @throws `av::Error` (or any other exception) raised on the encoder thread
+	 */
+	Expected<AVPacket *> try_receive_packet()
+	{
+		auto pkt = _packets.try_pop();
+		if (!pkt && _packets.closed())
+		{
+			// pick up anything queued just before closing
+			if (!(pkt = _packets.try_pop()))
+			{
+				check_error();
+				return std::unexpected{AVERROR_EOF};
+			}
+		}
+		if (!pkt)
+			return std::unexpected{AVERROR(EAGAIN)};
+		_pkt = std::move(*pkt);
+		return _pkt;
+	}
+
+	/**
+	 * Signal the end of the stream and wait until every queued frame has been
+	 * encoded and the encoder has been drained. With a callback, every
+	 * packet has been delivered when this returns; otherwise, keep calling
+	 * `receive_packet()` until it returns `NULL` instead.
+	 * @throws `av::Error` (or any other exception) raised on the encoder thread
+	 */
+	void flush()
+	{
+		_frames.close();
+		if (_callback && _thread.joinable())
+			_thread.join();
+		check_error();
+	}
+
+private:
+	void check_error()
+	{
+		if (_packets.closed() && _error)
+			std::rethrow_exception(_error);
+	}
+
+	void run()
+	{
+		try
+		{
+			while (const auto frame = _frames.pop())
+			{
+				if (_abort)
+					return;
+				_encoder.send_frame(*frame);
+				if (!drain())
+					return;
+			}
+			if (_abort)
+				return;
+			_encoder.send_frame(NULL);
+			drain();
+		}
+		catch (...)
+		{
+			_error = std::current_exception();
+		}
+		_packets.close();
+		// unblock the producer if we stopped early
+		_frames.close();
+	}
+
+	/**
+	 * @return `false` if the encoder is being abandoned.
+	 */
+	bool drain()
+	{
+		if (_callback)
+		{
+			while (const auto pkt = _encoder.receive_packet())
+			{
+				_callback(pkt);
+				av_packet_unref(pkt);
+			}
+			return true;
+		}
+		while (auto pkt = _encoder.receive_packet(_pool))
+		{
+			const size_t size = pkt->size;
+			if (!_packets.push(std::move(pkt), size))
+				return false;
+		}
+		return true;
+	}
+};
+
+} // namespace av
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <span>
+
+#include "Error.hpp"
+#include "Frame.hpp"
+#include "PlaneView.hpp"
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+namespace av
+{
+
+/**
+ * `Frame` statically known to be in the sample format `Fmt`. Its sample type
+ * and layout (planar or interleaved) are compile-time constants (from
+ * `SampleTraits`), so code written against it needs no sample format lookups
+ * or per-format branches. Non-owning, like `Frame`.
+ */
+template <AVSampleFormat Fmt>
+class AudioFrame : public Frame
+{
+public:
+	using traits = SampleTraits<Fmt>;
+	using sample_type = typename traits::sample;
+
+	static constexpr AVSampleFormat format = Fmt;
+	static constexpr bool planar = traits::planar;
+
+	/**
+	 * Checked conversion from a dynamically typed frame.
+	 * @throws `av::Error` if `f` is `NULL` or not in the format `Fmt`
+	 */
+	explicit AudioFrame(AVFrame *const f)
+		: Frame{f}
+	{
+		if (!matches(f))
+			throw Error("AudioFrame", AVERROR(EINVAL));
+	}
+
+	/**
+	 * Non-throwing checked conversion.
+	 * @return The typed frame, or `AVERROR(EINVAL)` if `f` is `NULL` or not
+	 * in the format `Fmt`.
+	 */
+	static Expected<AudioFrame> try_from(AVFrame *const f)
+	{
+		if (!matches(f))
+			return std::unexpected{AVERROR(EINVAL)};
+		return AudioFrame{f};
+	}
+
+	static bool matches(const AVFrame *const f)
+	{
+		return f && f->format == Fmt;
+	}
+
+	int nb_samples() const { return _f->nb_samples; }
+	int nb_channels() const { return _f->ch_layout.nb_channels; }
+
+	/**
+	 * @return The samples of channel `ch`, which must exist.
+	 */
+	std::span<sample_type> channel(const int ch) const
+		requires planar
+	{
+		return {
+			reinterpret_cast<sample_type *>(_f->extended_data[ch]),
+			static_cast<size_t>(_f->nb_samples)};
+	}
+
+	/**
+	 * @return All samples, indexed `[sample, channel]`.
+	 */
+	PlaneView<sample_type> samples() const
+		requires(!planar)
+	{
+		const size_t channels = nb_channels();
+		return {
+			reinterpret_cast<sample_type *>(_f->data[0]),
+			channels,
+			static_cast<size_t>(_f->nb_samples),
+			static_cast<ptrdiff_t>(channels * sizeof(sample_type))};
+	}
+
+	/**
+	 * @return The size of the samples, without padding, in bytes.
+	 */
+	size_t data_size() const
+	{
+		return static_cast<size_t>(_f->nb_samples) * nb_channels() *
+			   sizeof(sample_type);
+	}
+};
+
+} // namespace av
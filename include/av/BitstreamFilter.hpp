@@ -0,0 +1,183 @@
+#pragma once
+
+#include "Error.hpp"
+#include "Stream.hpp"
+
+extern "C"
+{
+#include <libavcodec/bsf.h>
+}
+
+namespace av
+{
+
+/**
+ * Owning wrapper over an `AVBSFContext`: a packet-level transform such as
+ * `h264_mp4toannexb`, `extract_extradata` or `h264_metadata`, applied without
+ * decoding. Packets are passed by reference, so payloads are not copied unless
+ * the filter itself rewrites them.
+ */
+class BitstreamFilter
+{
+	AVBSFContext *_bsf{};
+	AVPacket *_pkt{};
+
+public:
+	/**
+	 * Parse a filter or a chain of filters, e.g.
+	 * `"h264_mp4toannexb"` or `"h264_metadata=level=4.1,dump_extra"`. An empty
+	 * string creates a pass-through filter. Set the input parameters, then
+	 * call `init()`.
+	 * @throws `av::Error` if `av_bsf_list_parse_str` fails
+	 */
+	BitstreamFilter(const char *const str)
+	{
+		if (const auto rc = av_bsf_list_parse_str(str, &_bsf); rc < 0)
+			throw Error("av_bsf_list_parse_str", rc);
+	}
+
+	/**
+	 * Parse `str` and initialize the filter for packets of `stream`.
+	 * @throws `av::Error` if parsing or initialization fails
+	 */
+	BitstreamFilter(const char *const str, const Stream &stream)
+		: BitstreamFilter{str}
+	{
+		copy_params(stream);
+		init();
+	}
+
+	~BitstreamFilter()
+	{
+		av_packet_free(&_pkt);
+		av_bsf_free(&_bsf);
+	}
+
+	BitstreamFilter(const BitstreamFilter &) = delete;
+	BitstreamFilter &operator=(const BitstreamFilter &) = delete;
+
+	BitstreamFilter(BitstreamFilter &&other) noexcept
+		: _bsf{other._bsf},
+		  _pkt{other._pkt}
+	{
+		other._bsf = {};
+		other._pkt = {};
+	}
+
+	BitstreamFilter &operator=(BitstreamFilter &&other) noexcept
+	{
+		if (this != &other)
+		{
+			av_packet_free(&_pkt);
+			av_bsf_free(&_bsf);
+			_bsf = other._bsf;
+			_pkt = other._pkt;
+			other._bsf = {};
+			other._pkt = {};
+		}
+		return *this;
+	}
+
+	AVBSFContext *operator->() const { return _bsf; }
+	operator AVBSFContext *() const { return _bsf; }
+
+	/**
+	 * Set the input codec parameters. Must be called before `init()`.
+	 * @throws `av::Error` if `avcodec_parameters_copy` fails
+	 */
+	void copy_params(const AVCodecParameters *const par)
+	{
+		if (const auto rc = avcodec_parameters_copy(_bsf->par_in, par); rc < 0)
+			throw Error("avcodec_parameters_copy", rc);
+	}
+
+	/**
+	 * Set the input codec parameters and time base from `stream`. Must be
+	 * called before `init()`.
+	 */
+	void copy_params(const Stream &stream)
+	{
+		copy_params(stream->codecpar);
+		_bsf->time_base_in = stream->time_base;
+	}
+
+	/**
+	 * Prepare the filter for use. Afterwards the output parameters are
+	 * available in `par_out` and `time_base_out`, e.g. to set up an output
+	 * stream with `Stream::copy_params(bsf->par_out)`.
+	 * @throws `av::Error` if `av_bsf_init` fails
+	 */
+	void init()
+	{
+		if (const auto rc = av_bsf_init(_bsf); rc < 0)
+			throw Error("av_bsf_init", rc);
+	}
+
+	/**
+	 * Send a packet to the filter, taking its reference: on success `pkt` is
+	 * left blank.
+	 * @param pkt `NULL` (or an empty packet) signals the end of the stream.
+	 * @return `false` if the filter first needs its output to be received, in
+	 * which case `pkt` is left untouched.
+	 * @throws `av::Error` if `av_bsf_send_packet` fails
+	 */
+	bool send_packet(AVPacket *const pkt)
+	{
+		switch (const auto rc = av_bsf_send_packet(_bsf, pkt))
+		{
+		case 0:
+			return true;
+		case AVERROR(EAGAIN):
+			return false;
+		default:
+			throw Error("av_bsf_send_packet", rc);
+		}
+	}
+
+	/**
+	 * Receive a filtered packet into `pkt`, which must be blank.
+	 * @return `false` if more input is needed, or the filter has been fully
+	 * flushed.
+	 * @throws `av::Error` if `av_bsf_receive_packet` fails
+	 */
+	bool receive_packet(AVPacket *const pkt)
+	{
+		switch (const auto rc = av_bsf_receive_packet(_bsf, pkt))
+		{
+		case 0:
+			return true;
+		case AVERROR(EAGAIN):
+		case AVERROR_EOF:
+			return false;
+		default:
+			throw Error("av_bsf_receive_packet", rc);
+		}
+	}
+
+	/**
+	 * Receive a filtered packet. Call in a loop: one input packet can yield
+	 * several output packets.
+	 * @retval On success, a pointer to the internal `AVPacket`.
+	 * @retval `NULL` if more input is needed, or the filter has been fully
+	 * flushed.
+	 * @throws `av::Error` if `av_bsf_receive_packet` fails
+	 * @warning **Do not free/delete the returned pointer.** It belongs to and
+	 * is managed by this class. Its reference may be moved out (e.g. by
+	 * `MediaWriter::write_packet`).
+	 */
+	AVPacket *receive_packet()
+	{
+		if (!_pkt && !(_pkt = av_packet_alloc()))
+			throw Error("av_packet_alloc", AVERROR(ENOMEM));
+		av_packet_unref(_pkt);
+		return receive_packet(_pkt) ? _pkt : NULL;
+	}
+
+	/**
+	 * Reset the internal state, e.g. after seeking the input, dropping any
+	 * buffered packets.
+	 */
+	void flush() { av_bsf_flush(_bsf); }
+};
+
+} // namespace av
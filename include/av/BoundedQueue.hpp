@@ -0,0 +1,133 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace av
+{
+
+/**
+ * Thread-safe FIFO bounded by both an item count and a byte budget, used to
+ * hand ref-counted packets and frames between pipeline threads. Producers
+ * block while the queue is full; consumers block while it is empty.
+ */
+template <typename T>
+class BoundedQueue
+{
+	std::deque<std::pair<T, size_t>> _items;
+	const size_t _max_items, _max_bytes;
+	size_t _bytes{};
+	bool _closed{};
+	std::mutex _mtx;
+	std::condition_variable _not_empty, _not_full;
+
+public:
+	/**
+	 * @param max_items Maximum number of queued items.
+	 * @param max_bytes Maximum sum of the `bytes` passed to `push()` over all
+	 * queued items.
+	 */
+	BoundedQueue(const size_t max_items, const size_t max_bytes = SIZE_MAX)
+		: _max_items{max_items ? max_items : 1},
+		  _max_bytes{max_bytes}
+	{
+	}
+
+	/**
+	 * Append `item`, blocking while the queue is full. An empty queue always
+	 * accepts an item, so a single item larger than `max_bytes` can't
+	 * deadlock the producer.
+	 * @return `false` if the queue was closed; `item` is dropped.
+	 */
+	bool push(T item, const size_t bytes = 0)
+	{
+		std::unique_lock lock{_mtx};
+		_not_full.wait(
+			lock,
+			[&]
+			{
+				return _closed || _items.empty() ||
+					   (_items.size() < _max_items &&
+						_bytes + bytes <= _max_bytes);
+			});
+		if (_closed)
+			return false;
+		_items.emplace_back(std::move(item), bytes);
+		_bytes += bytes;
+		lock.unlock();
+		_not_empty.notify_one();
+		return true;
+	}
+
+	/**
+	 * Remove the oldest item, blocking while the queue is empty and open.
+	 * @return The item, or `std::nullopt` once the queue is closed and empty.
+	 */
+	std::optional<T> pop()
+	{
+		std::unique_lock lock{_mtx};
+		_not_empty.wait(lock, [&] { return _closed || !_items.empty(); });
+		return pop_locked(lock);
+	}
+
+	/**
+	 * Non-blocking `pop()`.
+	 * @return The oldest item, or `std::nullopt` if the queue is empty.
+	 */
+	std::optional<T> try_pop()
+	{
+		std::unique_lock lock{_mtx};
+		return pop_locked(lock);
+	}
+
+	/**
+	 * Reject further pushes and wake all waiters. Items already queued can
+	 * still be popped.
+	 */
+	void close()
+	{
+		{
+			std::lock_guard lock{_mtx};
+			_closed = true;
+		}
+		_not_empty.notify_all();
+		_not_full.notify_all();
+	}
+
+	/**
+	 * Drop all queued items and reopen the queue.
+	 */
+	void reset()
+	{
+		std::lock_guard lock{_mtx};
+		_items.clear();
+		_bytes = 0;
+		_closed = false;
+	}
+
+	bool closed()
+	{
+		std::lock_guard lock{_mtx};
+		return _closed;
+	}
+
+private:
+	std::optional<T> pop_locked(std::unique_lock<std::mutex> &lock)
+	{
+		if (_items.empty())
+			return std::nullopt;
+		auto [item, bytes] = std::move(_items.front());
+		_items.pop_front();
+		_bytes -= bytes;
+		lock.unlock();
+		_not_full.notify_one();
+		return std::move(item);
+	}
+};
+
+} // namespace av
@@ -29,6 +29,17 @@ struct BufferSink : FilterContext
 			throw Error("av_buffersink_get_frame", rc);
 	}
 
+	/**
+	 * Non-throwing `get_frame`, for pulling frames in a loop without using
+	 * exceptions for `AVERROR(EAGAIN)` and `AVERROR_EOF`.
+	 */
+	Expected<void> try_get_frame(AVFrame *const frame)
+	{
+		if (const int rc = av_buffersink_get_frame(ctx, frame); rc < 0)
+			return std::unexpected{rc};
+		return {};
+	}
+
 	void operator>>(AVFrame *const frame) { get_frame(frame); }
 
 private:
@@ -46,6 +46,16 @@ struct BufferSrc : FilterContext
 			throw Error("av_buffersrc_add_frame", rc);
 	}
 
+	/**
+	 * Non-throwing `add_frame`.
+	 */
+	Expected<void> try_add_frame(AVFrame *const frame)
+	{
+		if (const int rc = av_buffersrc_add_frame(ctx, frame); rc < 0)
+			return std::unexpected{rc};
+		return {};
+	}
+
 	void parameters_set(AVBufferSrcParameters *const p)
 	{
 		if (const int rc = av_buffersrc_parameters_set(ctx, p); rc < 0)
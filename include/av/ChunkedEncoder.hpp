@@ -0,0 +1,341 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+#include "Encoder.hpp"
+#include "Error.hpp"
+#include "Frame.hpp"
+#include "MediaWriter.hpp"
+#include "Packet.hpp"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace av
+{
+
+/**
+ * Encodes one stream with many independent encoders at once, for encoders
+ * that scale poorly past a few threads (e.g. libx264). Input frames are cut
+ * into chunks at source keyframes (typically scene cuts) once a chunk is long
+ * enough; each chunk is encoded from scratch by its own `Encoder` on a worker
+ * thread, so it starts with a keyframe and its GOPs are closed. Encoded chunks
+ * are written to a `MediaWriter` stream in order, on the calling thread.
+ *
+ * Every encoder must be created with identical settings, so that they produce
+ * the same stream parameters, extradata and reordering delay. Frames waiting
+ * to be encoded are bounded by `Options::max_bytes`: once it is reached,
+ * `send_frame()` blocks until the oldest chunk is written, or ends the current
+ * chunk early if it is the only one.
+ */
+class ChunkedEncoder
+{
+public:
+	/**
+	 * Creates an opened encoder for a new chunk. Called concurrently from the
+	 * worker threads.
+	 */
+	using EncoderFactory = std::function<std::unique_ptr<Encoder>()>;
+
+	struct Options
+	{
+		// minimum number of frames per chunk; a chunk ends at the next source
+		// keyframe after this many frames
+		size_t chunk_frames = 120;
+		// hard limit on the frames per chunk when keyframes are sparse; `0`
+		// means twice `chunk_frames`
+		size_t max_chunk_frames = 0;
+		// number of chunks encoded concurrently; `0` means one per core
+		unsigned nb_threads = 0;
+		// budget for the data of the frames held in memory, over all chunks
+		size_t max_bytes = size_t{2} << 30;
+	};
+
+private:
+	struct Chunk
+	{
+		std::vector<OwnedFrame> frames;
+		std::vector<OwnedPacket> packets;
+		// size of the frames' data, counted in `_bytes_held`
+		size_t bytes{};
+		// time base of the packets, i.e. of the chunk's encoder
+		AVRational time_base{};
+		// pts of the first frame minus dts of the first packet
+		int64_t delay{AV_NOPTS_VALUE};
+		std::exception_ptr error;
+		bool done{};
+	};
+
+	const EncoderFactory _factory;
+	MediaWriter &_writer;
+	const int _stream_index;
+	const size_t _chunk_frames, _max_chunk_frames, _max_pending, _max_bytes;
+
+	std::unique_ptr<Chunk> _current{std::make_unique<Chunk>()};
+	// dispatched chunks, oldest first
+	std::deque<std::unique_ptr<Chunk>> _pending;
+	size_t _nb_chunks{};
+	int64_t _delay{AV_NOPTS_VALUE};
+	// released by the workers once a chunk's frames are encoded
+	std::atomic<size_t> _bytes_held{};
+	// packets are written and returned to the pool a chunk at a time
+	PacketPool _pool{1024};
+
+	BoundedQueue<Chunk *> _jobs{SIZE_MAX};
+	std::mutex _mtx;
+	std::condition_variable _done;
+	std::atomic<bool> _abort{};
+	std::vector<std::jthread> _workers;
+
+public:
+	/**
+	 * Start the worker threads.
+	 * @param factory Creates the encoders. Frames are passed to them with the
+	 * timestamps given to `send_frame()`, which must be in the encoders' time
+	 * base.
+	 * @param writer Receives the packets. Its header must have been written
+	 * before the first packet is, i.e. before `send_frame()` completes a
+	 * chunk. Must outlive this object.
+	 * @param stream_index Output stream of `writer` to write to.
+	 */
+	ChunkedEncoder(
+		EncoderFactory factory,
+		MediaWriter &writer,
+		const int stream_index,
+		const Options &opts)
+		: _factory{std::move(factory)},
+		  _writer{writer},
+		  _stream_index{stream_index},
+		  _chunk_frames{std::max<size_t>(opts.chunk_frames, 1)},
+		  _max_chunk_frames{
+			  opts.max_chunk_frames
+				  ? std::max(opts.max_chunk_frames, _chunk_frames)
+				  : _chunk_frames * 2},
+		  _max_pending{
+			  (opts.nb_threads
+				   ? opts.nb_threads
+				   : std::max(1u, std::thread::hardware_concurrency())) +
+			  1u},
+		  _max_bytes{opts.max_bytes}
+	{
+		for (size_t i = 0; i + 1 < _max_pending; ++i)
+			_workers.emplace_back(&ChunkedEncoder::work, this);
+	}
+
+	ChunkedEncoder(
+		EncoderFactory factory, MediaWriter &writer, const int stream_index)
+		: ChunkedEncoder{std::move(factory), writer, stream_index, Options{}}
+	{
+	}
+
+	/**
+	 * Abandon any chunks not yet written. Call `flush()` first to write
+	 * everything.
+	 */
+	~ChunkedEncoder()
+	{
+		_abort = true;
+		_jobs.close();
+		_workers.clear();
+	}
+
+	ChunkedEncoder(const ChunkedEncoder &) = delete;
+	ChunkedEncoder &operator=(const ChunkedEncoder &) = delete;
+
+	/**
+	 * Add a new reference to `frame` to the current chunk, dispatching the
+	 * chunk first if `frame` starts a new one, and write out the chunks that
+	 * have finished encoding. Blocks while all workers are busy or the memory
+	 * budget is used up, and the oldest chunk isn't done.
+	 * @throws `av::Error` (or any other exception) from encoding or writing
+	 */
+	void send_frame(const AVFrame *const frame)
+	{
+		const auto n = _current->frames.size();
+		if (n >= _max_chunk_frames || (n >= _chunk_frames && is_key(frame)))
+			dispatch();
+
+		OwnedFrame ref;
+		if (const auto rc = av_frame_ref(ref, frame); rc < 0)
+			throw Error("av_frame_ref", rc);
+		// let each encoder place its own keyframes
+		ref->pict_type = AV_PICTURE_TYPE_NONE;
+
+		const auto size = data_size(ref);
+		while (_bytes_held + size > _max_bytes)
+		{
+			if (!_pending.empty())
+				write_front();
+			else if (!_current->frames.empty())
+				dispatch();
+			else
+				break;
+		}
+		_current->frames.push_back(std::move(ref));
+		_current->bytes += size;
+		_bytes_held += size;
+
+		write_done(false);
+	}
+
+	/**
+	 * Encode the last chunk and wait until every chunk has been written.
+	 * @throws `av::Error` (or any other exception) from encoding or writing
+	 */
+	void flush()
+	{
+		if (!_current->frames.empty())
+			dispatch();
+		write_done(true);
+	}
+
+	/**
+	 * @return The number of chunks dispatched so far.
+	 */
+	size_t chunks() const { return _nb_chunks; }
+
+private:
+	static bool is_key(const AVFrame *const frame)
+	{
+		if (frame->pict_type == AV_PICTURE_TYPE_I)
+			return true;
+#ifdef AV_FRAME_FLAG_KEY
+		return frame->flags & AV_FRAME_FLAG_KEY;
+#else
+		return frame->key_frame;
+#endif
+	}
+
+	static size_t data_size(const AVFrame *const frame)
+	{
+		size_t size = 0;
+		for (const auto buf : frame->buf)
+			if (buf)
+				size += buf->size;
+		for (int i = 0; i < frame->nb_extended_buf; ++i)
+			size += frame->extended_buf[i]->size;
+		return size;
+	}
+
+	void dispatch()
+	{
+		_jobs.push(_current.get());
+		_pending.push_back(std::move(_current));
+		_current = std::make_unique<Chunk>();
+		++_nb_chunks;
+		// bound the frames held in memory
+		while (_pending.size() > _max_pending)
+			write_front();
+	}
+
+	/**
+	 * Write out finished chunks in order.
+	 * @param wait Whether to wait for all pending chunks to finish.
+	 */
+	void write_done(const bool wait)
+	{
+		while (!_pending.empty())
+		{
+			if (!wait)
+			{
+				std::lock_guard lock{_mtx};
+				if (!_pending.front()->done)
+					return;
+			}
+			write_front();
+		}
+	}
+
+	void write_front()
+	{
+		auto &chunk = *_pending.front();
+		{
+			std::unique_lock lock{_mtx};
+			_done.wait(lock, [&] { return chunk.done; });
+		}
+		if (chunk.error)
+			std::rethrow_exception(chunk.error);
+
+		// with the same reordering delay, the dts of consecutive chunks never
+		// overlap; anything else can't be fixed without moving pts
+		if (chunk.delay != AV_NOPTS_VALUE)
+		{
+			if (_delay == AV_NOPTS_VALUE)
+				_delay = chunk.delay;
+			else if (chunk.delay != _delay)
+				throw Error("ChunkedEncoder", AVERROR(EINVAL));
+		}
+
+		const auto tb = _writer->streams[_stream_index]->time_base;
+		for (const auto &pkt : chunk.packets)
+		{
+			av_packet_rescale_ts(pkt, chunk.time_base, tb);
+			pkt->stream_index = _stream_index;
+			_writer.write_packet(pkt);
+		}
+		_pending.pop_front();
+	}
+
+	void work()
+	{
+		while (const auto job = _jobs.pop())
+		{
+			if (_abort)
+				return;
+			auto &chunk = **job;
+			try
+			{
+				encode(chunk);
+			}
+			catch (...)
+			{
+				chunk.error = std::current_exception();
+			}
+			chunk.frames.clear();
+			_bytes_held -= chunk.bytes;
+			{
+				std::lock_guard lock{_mtx};
+				chunk.done = true;
+			}
+			_done.notify_all();
+		}
+	}
+
+	void encode(Chunk &chunk)
+	{
+		const auto encoder = _factory();
+		chunk.time_base = (*encoder)->time_base;
+		const auto first_pts = chunk.frames.front()->pts;
+		for (const auto &frame : chunk.frames)
+		{
+			encoder->send_frame(frame);
+			drain(*encoder, chunk);
+		}
+		encoder->send_frame(NULL);
+		drain(*encoder, chunk);
+
+		if (!chunk.packets.empty() && first_pts != AV_NOPTS_VALUE &&
+			chunk.packets.front()->dts != AV_NOPTS_VALUE)
+			chunk.delay = first_pts - chunk.packets.front()->dts;
+	}
+
+	void drain(Encoder &encoder, Chunk &chunk)
+	{
+		while (auto pkt = encoder.receive_packet(_pool))
+			chunk.packets.push_back(std::move(pkt));
+	}
+};
+
+} // namespace av
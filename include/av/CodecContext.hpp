@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <thread>
+
 #include "av/HWDeviceContext.hpp"
 extern "C"
 {
@@ -18,6 +21,26 @@ protected:
 	AVCodecContext *_cdctx{};
 
 public:
+	/**
+	 * Threading policy applied by `set_threading()`.
+	 */
+	enum class Threading
+	{
+		// frame and/or slice threading, whichever the codec supports
+		AUTO,
+		// one frame per thread: best throughput, but adds up to one frame of
+		// delay per thread
+		FRAME,
+		// slices of one frame in parallel: no added delay, but only helps
+		// streams encoded with several slices
+		SLICE,
+		// single-threaded
+		NONE,
+		// slice threading if the codec supports it, single-threaded otherwise;
+		// never adds delay
+		LOW_LATENCY,
+	};
+
 	/**
 	 * @param codec if non-`NULL`, allocate private data and initialize defaults
 	 * for the given codec. It is illegal to then call `avcodec_open2()` with a
@@ -89,6 +112,51 @@ public:
 			throw Error("avcodec_open2", rc);
 	}
 
+	/**
+	 * Select how the codec parallelizes its work. Must be called BEFORE
+	 * `open()`; without it, FFmpeg's default of a single thread applies.
+	 * @param count Number of threads; `0` picks one per core (at most 16, as
+	 * FFmpeg does). Ignored for `NONE`, and for `LOW_LATENCY` when the codec
+	 * has no slice threading.
+	 * @note Codecs with their own internal threading (e.g. libdav1d, libx264)
+	 * only honor `count`.
+	 */
+	void set_threading(const Threading mode, int count = 0)
+	{
+		const int caps = _cdctx->codec ? _cdctx->codec->capabilities : 0;
+		if (!count)
+			count = std::clamp<int>(std::thread::hardware_concurrency(), 1, 16);
+
+		switch (mode)
+		{
+		case Threading::AUTO:
+			_cdctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+			break;
+		case Threading::FRAME:
+			_cdctx->thread_type = FF_THREAD_FRAME;
+			break;
+		case Threading::SLICE:
+			_cdctx->thread_type = FF_THREAD_SLICE;
+			break;
+		case Threading::NONE:
+			count = 1;
+			break;
+		case Threading::LOW_LATENCY:
+			_cdctx->thread_type = FF_THREAD_SLICE;
+			if (!(caps & (AV_CODEC_CAP_SLICE_THREADS |
+						  AV_CODEC_CAP_OTHER_THREADS)))
+				count = 1;
+			break;
+		}
+		_cdctx->thread_count = count;
+	}
+
+	/**
+	 * Reset the internal codec state and drop any buffered frames or packets.
+	 * Call this after seeking the input feeding this context.
+	 */
+	void flush_buffers() { avcodec_flush_buffers(_cdctx); }
+
 	void set_hwdevice_ctx(const HWDeviceContext &hwdctx)
 	{
 		if (!(_cdctx->hw_device_ctx = av_buffer_ref(hwdctx)))
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <span>
+
 #include "CodecContext.hpp"
+#include "Frame.hpp"
+#include "Packet.hpp"
 
 extern "C"
 {
@@ -15,6 +20,84 @@ class Decoder : public CodecContext
 	AVFrame *_frm = nullptr;
 
 public:
+	/**
+	 * Speed/quality presets for `set_quality()`, for previews, proxies and
+	 * analysis that don't need exact output, from slowest to fastest:
+	 *
+	 * | preset      | loop filter | frames decoded | lowres | `FLAG2_FAST` |
+	 * |-------------|-------------|----------------|--------|--------------|
+	 * | `FULL`      | all         | all            | 0      | no           |
+	 * | `FAST`      | ref only    | all            | 0      | yes          |
+	 * | `PREVIEW`   | none        | ref only       | 1      | yes          |
+	 * | `DRAFT`     | none        | ref only       | 2      | yes          |
+	 * | `KEYFRAMES` | none        | keyframes only | 0      | yes          |
+	 *
+	 * - `FULL`: exact output.
+	 * - `FAST`: visually near-identical, but not bit-exact.
+	 * - `PREVIEW`: half size, some blocking; dropping non-reference frames
+	 * usually drops the B-frames, lowering the frame rate.
+	 * - `DRAFT`: like `PREVIEW`, at quarter size.
+	 * - `KEYFRAMES`: roughly one frame per GOP, some blocking.
+	 *
+	 * `lowres` only applies to decoders that support it (mostly JPEG and older
+	 * MPEG codecs), and is limited to `AVCodec::max_lowres`. Skipping the IDCT
+	 * is not used by any preset, since it breaks the frames that reference the
+	 * affected ones; set `QualityProfile::skip_idct` explicitly to use it.
+	 */
+	enum class Quality
+	{
+		FULL,
+		FAST,
+		PREVIEW,
+		DRAFT,
+		KEYFRAMES,
+	};
+
+	/**
+	 * The individual knobs set by a `Quality` preset.
+	 */
+	struct QualityProfile
+	{
+		AVDiscard skip_loop_filter = AVDISCARD_DEFAULT;
+		AVDiscard skip_idct = AVDISCARD_DEFAULT;
+		AVDiscard skip_frame = AVDISCARD_DEFAULT;
+		// decode at 1/2^lowres resolution
+		int lowres = 0;
+		// allow non-spec-compliant speedups (`AV_CODEC_FLAG2_FAST`)
+		bool fast = false;
+	};
+
+	/**
+	 * @return The knobs of `quality`, e.g. to adjust before `set_quality()`.
+	 */
+	static constexpr QualityProfile profile(const Quality quality)
+	{
+		switch (quality)
+		{
+		case Quality::FAST:
+			return {.skip_loop_filter = AVDISCARD_NONREF, .fast = true};
+		case Quality::PREVIEW:
+			return {
+				.skip_loop_filter = AVDISCARD_ALL,
+				.skip_frame = AVDISCARD_NONREF,
+				.lowres = 1,
+				.fast = true};
+		case Quality::DRAFT:
+			return {
+				.skip_loop_filter = AVDISCARD_ALL,
+				.skip_frame = AVDISCARD_NONREF,
+				.lowres = 2,
+				.fast = true};
+		case Quality::KEYFRAMES:
+			return {
+				.skip_loop_filter = AVDISCARD_ALL,
+				.skip_frame = AVDISCARD_NONKEY,
+				.fast = true};
+		default:
+			return {};
+		}
+	}
+
 	Decoder(const AVCodec *const codec = NULL)
 		: CodecContext(codec)
 	{
@@ -22,6 +105,28 @@ public:
 
 	~Decoder() { av_frame_free(&_frm); }
 
+	/**
+	 * Apply a speed/quality preset. Must be called BEFORE `open()`, since
+	 * `lowres` and `FLAG2_FAST` are only read when opening.
+	 */
+	void set_quality(const Quality quality) { set_quality(profile(quality)); }
+
+	/**
+	 * Apply individual speed/quality knobs. Must be called BEFORE `open()`.
+	 */
+	void set_quality(const QualityProfile &profile)
+	{
+		_cdctx->skip_loop_filter = profile.skip_loop_filter;
+		_cdctx->skip_idct = profile.skip_idct;
+		_cdctx->skip_frame = profile.skip_frame;
+		_cdctx->lowres = std::min<int>(
+			profile.lowres, _cdctx->codec ? _cdctx->codec->max_lowres : 0);
+		if (profile.fast)
+			_cdctx->flags2 |= AV_CODEC_FLAG2_FAST;
+		else
+			_cdctx->flags2 &= ~AV_CODEC_FLAG2_FAST;
+	}
+
 	/**
 	 * Sends a packet to the decoder.
 	 * @param packet can be `NULL` (or an `AVPacket` with data set to `NULL` and
@@ -46,6 +151,18 @@ public:
 		}
 	}
 
+	/**
+	 * Non-throwing `send_packet`. Unlike `send_packet`, `AVERROR(EAGAIN)` is
+	 * reported: the packet was not consumed and must be sent again after
+	 * receiving frames.
+	 */
+	Expected<void> try_send_packet(const AVPacket *const pkt)
+	{
+		if (const auto rc = avcodec_send_packet(_cdctx, pkt); rc < 0)
+			return std::unexpected{rc};
+		return {};
+	}
+
 	/**
 	 * Receive a frame from the decoder.
 	 * For audio, this method should be called in a loop since
@@ -72,6 +189,105 @@ public:
 			throw Error("avcodec_receive_frame", rc);
 		}
 	}
+
+	/**
+	 * Non-throwing `receive_frame`.
+	 * @return A pointer to the internal `AVFrame`, or the error, which is
+	 * `AVERROR(EAGAIN)` if a new packet is needed and `AVERROR_EOF` once
+	 * fully flushed.
+	 */
+	Expected<AVFrame *> try_receive_frame()
+	{
+		if (!_frm && !(_frm = av_frame_alloc()))
+			return std::unexpected{AVERROR(ENOMEM)};
+		if (const auto rc = avcodec_receive_frame(_cdctx, _frm); rc < 0)
+			return std::unexpected{rc};
+		return _frm;
+	}
+
+	/**
+	 * Receive a frame from the decoder into a frame owned by the caller,
+	 * e.g. an `OwnedFrame` to hand to another thread without copying.
+	 * @param frame Receives the frame. Any data it references is unreferenced
+	 * first.
+	 * @return `false` if either the codec requires a new packet to be sent,
+	 * or the codec has been fully flushed; `frame` is then left blank.
+	 * @throws `av::Error` if any `avcodec_*` functions fail
+	 */
+	bool receive_frame(AVFrame *const frame)
+	{
+		switch (const auto rc = avcodec_receive_frame(_cdctx, frame))
+		{
+		case 0:
+			return true;
+		case AVERROR(EAGAIN):
+		case AVERROR_EOF:
+			return false;
+		default:
+			throw Error("avcodec_receive_frame", rc);
+		}
+	}
+
+	/**
+	 * Non-throwing `receive_frame(AVFrame *)`.
+	 */
+	Expected<void> try_receive_frame(AVFrame *const frame)
+	{
+		if (const auto rc = avcodec_receive_frame(_cdctx, frame); rc < 0)
+			return std::unexpected{rc};
+		return {};
+	}
+
+	/**
+	 * Decode a batch of packets, appending every frame that becomes available
+	 * to `frames`. The decoder is only drained when it can't take more input
+	 * and once at the end, instead of after every packet.
+	 * @param pkts Packets to send, in order; a `NULL` entry flushes the
+	 * decoder, after which the remaining entries are ignored.
+	 * @return The number of frames appended.
+	 * @throws `av::Error` if any `avcodec_*` functions fail
+	 */
+	size_t decode(std::span<const AVPacket *const> pkts, FrameBatch &frames)
+	{
+		const auto start = frames.size();
+		for (const auto pkt : pkts)
+		{
+			int rc;
+			while ((rc = avcodec_send_packet(_cdctx, pkt)) == AVERROR(EAGAIN))
+				if (!drain(frames))
+					throw Error("avcodec_send_packet", rc);
+			if (rc == AVERROR_EOF)
+				break;
+			if (rc < 0)
+				throw Error("avcodec_send_packet", rc);
+		}
+		drain(frames);
+		return frames.size() - start;
+	}
+
+	size_t decode(const PacketBatch &pkts, FrameBatch &frames)
+	{
+		return decode(pkts.packets(), frames);
+	}
+
+private:
+	/**
+	 * Receive every frame available without more input.
+	 * @return The number of frames appended to `frames`.
+	 */
+	size_t drain(FrameBatch &frames)
+	{
+		for (size_t n = 0;; ++n)
+		{
+			const auto rc = avcodec_receive_frame(_cdctx, frames.next());
+			if (rc >= 0)
+				continue;
+			frames.pop_back();
+			if (rc == AVERROR(EAGAIN) || rc == AVERROR_EOF)
+				return n;
+			throw Error("avcodec_receive_frame", rc);
+		}
+	}
 };
 
 } // namespace av
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <span>
+
 #include "CodecContext.hpp"
 #include "Error.hpp"
+#include "Packet.hpp"
 
 extern "C"
 {
@@ -37,6 +40,18 @@ public:
 		}
 	}
 
+	/**
+	 * Non-throwing `send_frame`. Unlike `send_frame`, `AVERROR(EAGAIN)` is
+	 * reported: the frame was not consumed and must be sent again after
+	 * receiving packets.
+	 */
+	Expected<void> try_send_frame(const AVFrame *const frm)
+	{
+		if (const auto rc = avcodec_send_frame(_cdctx, frm); rc < 0)
+			return std::unexpected{rc};
+		return {};
+	}
+
 	AVPacket *receive_packet()
 	{
 		if (!_pkt && !(_pkt = av_packet_alloc()))
@@ -52,6 +67,88 @@ public:
 			throw Error("avcodec_receive_packet", rc);
 		}
 	}
+
+	/**
+	 * Receive a packet into a packet from `pool`, which the caller owns, e.g.
+	 * to queue it to a muxing thread.
+	 * @return The packet, or an empty packet if a new frame is needed or the
+	 * encoder has been fully flushed.
+	 */
+	OwnedPacket receive_packet(PacketPool &pool)
+	{
+		auto pkt = pool.get();
+		switch (const auto rc = avcodec_receive_packet(_cdctx, pkt))
+		{
+		case 0:
+			return pkt;
+		case AVERROR(EAGAIN):
+		case AVERROR_EOF:
+			return nullptr;
+		default:
+			throw Error("avcodec_receive_packet", rc);
+		}
+	}
+
+	/**
+	 * Non-throwing `receive_packet`.
+	 * @return A pointer to the internal `AVPacket`, or the error, which is
+	 * `AVERROR(EAGAIN)` if a new frame is needed and `AVERROR_EOF` once
+	 * fully flushed.
+	 */
+	Expected<AVPacket *> try_receive_packet()
+	{
+		if (!_pkt && !(_pkt = av_packet_alloc()))
+			return std::unexpected{AVERROR(ENOMEM)};
+		if (const auto rc = avcodec_receive_packet(_cdctx, _pkt); rc < 0)
+			return std::unexpected{rc};
+		return _pkt;
+	}
+
+	/**
+	 * Encode a batch of frames, appending every packet that becomes available
+	 * to `pkts`. The encoder is only drained when it can't take more input
+	 * and once at the end, instead of after every frame.
+	 * @param frames Frames to send, in order; a `NULL` entry flushes the
+	 * encoder, after which the remaining entries are ignored.
+	 * @return The number of packets appended.
+	 * @throws `av::Error` if any `avcodec_*` functions fail
+	 */
+	size_t encode(std::span<const AVFrame *const> frames, PacketBatch &pkts)
+	{
+		const auto start = pkts.size();
+		for (const auto frame : frames)
+		{
+			int rc;
+			while ((rc = avcodec_send_frame(_cdctx, frame)) == AVERROR(EAGAIN))
+				if (!drain(pkts))
+					throw Error("avcodec_send_frame", rc);
+			if (rc == AVERROR_EOF)
+				break;
+			if (rc < 0)
+				throw Error("avcodec_send_frame", rc);
+		}
+		drain(pkts);
+		return pkts.size() - start;
+	}
+
+private:
+	/**
+	 * Receive every packet available without more input.
+	 * @return The number of packets appended to `pkts`.
+	 */
+	size_t drain(PacketBatch &pkts)
+	{
+		for (size_t n = 0;; ++n)
+		{
+			const auto rc = avcodec_receive_packet(_cdctx, pkts.next());
+			if (rc >= 0)
+				continue;
+			pkts.pop_back();
+			if (rc == AVERROR(EAGAIN) || rc == AVERROR_EOF)
+				return n;
+			throw Error("avcodec_receive_packet", rc);
+		}
+	}
 };
 
 } // namespace av
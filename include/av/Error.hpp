@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdio>
+#include <expected>
+#include <mutex>
 #include <stdexcept>
 
 extern "C"
@@ -12,15 +15,59 @@ namespace av
 
 struct Error : std::runtime_error
 {
+	// must point to a string with static storage duration, e.g. a literal
 	const char *const func;
 	const int errnum;
 
+	/**
+	 * Cheap to construct: the message is only formatted by `what()`.
+	 */
 	Error(const char *const func, const int errnum)
-		: std::runtime_error{std::string{func} + ": " + av_err2str(errnum)},
+		: std::runtime_error{func},
 		  func{func},
 		  errnum{errnum}
 	{
 	}
+
+	/**
+	 * The message of a copy is formatted again on its first `what()`.
+	 */
+	Error(const Error &other) noexcept
+		: std::runtime_error{other},
+		  func{other.func},
+		  errnum{other.errnum}
+	{
+	}
+
+	/**
+	 * @return `"<func>: <description of errnum>"`, formatted on first use.
+	 * @note Thread-safe, e.g. for an exception shared through an
+	 * `std::exception_ptr`.
+	 */
+	const char *what() const noexcept override
+	{
+		std::call_once(
+			_formatted,
+			[this]
+			{
+				char err[AV_ERROR_MAX_STRING_SIZE];
+				av_strerror(errnum, err, sizeof err);
+				std::snprintf(_msg, sizeof _msg, "%s: %s", func, err);
+			});
+		return _msg;
+	}
+
+private:
+	mutable std::once_flag _formatted;
+	mutable char _msg[128]{};
 };
 
+/**
+ * Result of the non-throwing `try_*` variants: the value, or the negative
+ * `AVERROR` code that the throwing variant would have thrown (including
+ * `AVERROR(EAGAIN)` and `AVERROR_EOF`).
+ */
+template <typename T>
+using Expected = std::expected<T, int>;
+
 } // namespace av
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <span>
+#include <vector>
+
 #include "Error.hpp"
 
 extern "C"
@@ -87,6 +90,88 @@ public:
 	// Do NOT allow copying an owned frame!
 	OwnedFrame(const OwnedFrame &) = delete;
 	OwnedFrame &operator=(const OwnedFrame &) = delete;
+
+	/**
+	 * Take over the `AVFrame` of `other`, which is left empty (`NULL`) and
+	 * may only be destroyed or assigned to.
+	 */
+	OwnedFrame(OwnedFrame &&other) noexcept
+		: Frame{other._f}
+	{
+		other._f = {};
+	}
+
+	OwnedFrame &operator=(OwnedFrame &&other) noexcept
+	{
+		if (this != &other)
+		{
+			av_frame_free(&_f);
+			_f = other._f;
+			other._f = {};
+		}
+		return *this;
+	}
+};
+
+/**
+ * Reusable list of frames for the batch APIs (`Decoder::decode()`). Clearing
+ * the batch only unreferences the frames, so refilling it reuses the same
+ * `AVFrame`s instead of allocating new ones.
+ */
+class FrameBatch
+{
+	std::vector<OwnedFrame> _frames;
+	size_t _size{};
+
+public:
+	FrameBatch(const size_t capacity = 0) { _frames.reserve(capacity); }
+
+	FrameBatch(const FrameBatch &) = delete;
+	FrameBatch &operator=(const FrameBatch &) = delete;
+
+	size_t size() const { return _size; }
+	bool empty() const { return !_size; }
+
+	/**
+	 * The frames currently in the batch. A frame may be moved out to keep it;
+	 * its slot gets a new `AVFrame` when reused.
+	 */
+	std::span<OwnedFrame> frames() { return {_frames.data(), _size}; }
+	auto begin() { return frames().begin(); }
+	auto end() { return frames().end(); }
+	OwnedFrame &operator[](const size_t i) { return _frames[i]; }
+
+	/**
+	 * Append an empty frame to the batch.
+	 * @return The frame, to be filled by the caller.
+	 */
+	AVFrame *next()
+	{
+		if (_size == _frames.size())
+			_frames.emplace_back();
+		else if (!_frames[_size])
+			// moved out by the caller
+			_frames[_size] = OwnedFrame{};
+		return _frames[_size++];
+	}
+
+	/**
+	 * Remove the last frame, e.g. after failing to fill it.
+	 */
+	void pop_back()
+	{
+		if (auto &frame = _frames[--_size]; frame)
+			frame.unref();
+	}
+
+	/**
+	 * Remove every frame, keeping the `AVFrame`s for reuse.
+	 */
+	void clear()
+	{
+		while (_size)
+			pop_back();
+	}
 };
 
 } // namespace av
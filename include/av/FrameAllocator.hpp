@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#include <sys/mman.h>
+
+#include "Decoder.hpp"
+#include "Util.hpp"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/version.h>
+}
+
+namespace av
+{
+
+/**
+ * Frame buffer allocator for video decoders, installed through
+ * `AVCodecContext::get_buffer2`. Plane buffers come from size-classed
+ * `AVBufferPool`s with a configurable alignment (of both the planes and their
+ * line sizes) and, optionally, transparent huge pages, so long-running
+ * decoders recycle the same memory instead of churning the heap.
+ *
+ * Decoders without `AV_CODEC_CAP_DR1`, hardware frames and audio are left to
+ * FFmpeg's default allocator.
+ * @note Safe to share between decoders, including frame-threaded ones.
+ */
+class FrameAllocator
+{
+public:
+	struct Options
+	{
+		// alignment of plane pointers and line sizes, in bytes (see
+		// `buffer_alignment()`)
+		size_t alignment = 64;
+		// ask for transparent huge pages (`MADV_HUGEPAGE`) on buffers of 2 MiB
+		// or more
+		bool huge_pages = false;
+	};
+
+	struct Stats
+	{
+		// plane buffers handed out from the pools
+		uint64_t gets{};
+		// pool misses, i.e. buffers that had to be newly allocated
+		uint64_t misses{};
+		// frames left to FFmpeg's default allocator
+		uint64_t fallbacks{};
+		// total size of the buffers allocated by the pools
+		uint64_t bytes_allocated{};
+
+		uint64_t hits() const { return gets - misses; }
+	};
+
+private:
+	static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	const size_t _alignment;
+	const bool _huge_pages;
+	std::mutex _mtx;
+	// by size class
+	std::map<size_t, AVBufferPool *> _pools;
+	std::atomic<uint64_t> _gets{}, _misses{}, _fallbacks{}, _bytes{};
+
+public:
+	/**
+	 * @throws `av::Error` if the alignment is not a power of two
+	 */
+	FrameAllocator(const Options &opts)
+		: _alignment{buffer_alignment(opts.alignment)},
+		  _huge_pages{opts.huge_pages}
+	{
+	}
+
+	FrameAllocator()
+		: FrameAllocator{Options{}}
+	{
+	}
+
+	/**
+	 * Buffers still referenced by frames stay valid: each pool is freed once
+	 * its last buffer is returned.
+	 */
+	~FrameAllocator()
+	{
+		for (auto &[_, pool] : _pools)
+			av_buffer_pool_uninit(&pool);
+	}
+
+	FrameAllocator(const FrameAllocator &) = delete;
+	FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+	/**
+	 * Make `decoder` allocate its frames from this allocator. Must be called
+	 * BEFORE `open()`. This allocator must outlive the decoder.
+	 * @warning Takes over `decoder->opaque`, which must not be used for
+	 * anything else (e.g. in a `get_format` callback) afterwards.
+	 */
+	void install(Decoder &decoder)
+	{
+		decoder->opaque = this;
+		decoder->get_buffer2 = get_buffer2;
+	}
+
+	Stats stats() const
+	{
+		return {_gets, _misses, _fallbacks, _bytes};
+	}
+
+private:
+	static int get_buffer2(
+		AVCodecContext *const ctx, AVFrame *const frame, const int flags)
+	{
+		auto &self = *static_cast<FrameAllocator *>(ctx->opaque);
+		const auto desc =
+			av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+		if (!(ctx->codec->capabilities & AV_CODEC_CAP_DR1) ||
+			ctx->codec_type != AVMEDIA_TYPE_VIDEO || !desc ||
+			desc->flags & AV_PIX_FMT_FLAG_HWACCEL)
+		{
+			++self._fallbacks;
+			return avcodec_default_get_buffer2(ctx, frame, flags);
+		}
+		return self.video_get_buffer(ctx, frame);
+	}
+
+	int video_get_buffer(AVCodecContext *const ctx, AVFrame *const frame)
+	{
+		const auto format = static_cast<AVPixelFormat>(frame->format);
+		int w = frame->width, h = frame->height;
+		int linesize_align[AV_NUM_DATA_POINTERS];
+		avcodec_align_dimensions2(ctx, &w, &h, linesize_align);
+
+		int linesize[4];
+		size_t sizes[4];
+		if (const auto rc = image_plane_layout(
+				linesize, sizes, format, w, h, _alignment, linesize_align);
+			rc < 0)
+			return rc;
+
+		for (int i = 0; i < 4 && sizes[i]; ++i)
+		{
+			const auto pool = get_pool(sizes[i]);
+			if (!pool || !(frame->buf[i] = av_buffer_pool_get(pool)))
+			{
+				for (auto &buf : frame->buf)
+					av_buffer_unref(&buf);
+				return AVERROR(ENOMEM);
+			}
+			++_gets;
+			frame->data[i] = frame->buf[i]->data;
+			frame->linesize[i] = linesize[i];
+		}
+		frame->extended_data = frame->data;
+		return 0;
+	}
+
+	AVBufferPool *get_pool(const size_t size)
+	{
+		const auto cls = size_class(size);
+		std::lock_guard lock{_mtx};
+		auto &pool = _pools[cls];
+		if (!pool)
+			pool = av_buffer_pool_init2(cls, this, alloc, NULL);
+		return pool;
+	}
+
+	/**
+	 * Round `size` up to one of four classes per power of two, so that
+	 * slightly different frame sizes share a pool.
+	 */
+	static size_t size_class(const size_t size)
+	{
+		if (size <= 4096)
+			return 4096;
+		const auto step = std::bit_floor(size - 1) / 4;
+		return (size + step - 1) / step * step;
+	}
+
+#if LIBAVUTIL_VERSION_MAJOR < 57
+	static AVBufferRef *alloc(void *const opaque, const int size)
+#else
+	static AVBufferRef *alloc(void *const opaque, const size_t size)
+#endif
+	{
+		auto &self = *static_cast<FrameAllocator *>(opaque);
+		const bool huge =
+			self._huge_pages && static_cast<size_t>(size) >= HUGE_PAGE_SIZE;
+		const auto alignment =
+			huge ? std::max(self._alignment, HUGE_PAGE_SIZE) : self._alignment;
+
+		void *data;
+		if (posix_memalign(&data, alignment, size))
+			return NULL;
+		if (huge)
+			madvise(data, size, MADV_HUGEPAGE);
+
+		const auto buf = av_buffer_create(
+			static_cast<uint8_t *>(data), size, free_buffer, NULL, 0);
+		if (!buf)
+		{
+			std::free(data);
+			return NULL;
+		}
+		++self._misses;
+		self._bytes += size;
+		return buf;
+	}
+
+	static void free_buffer(void *, uint8_t *const data) { std::free(data); }
+};
+
+} // namespace av
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Error.hpp"
+#include "Frame.hpp"
+#include "Util.hpp"
+
+extern "C"
+{
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace av
+{
+
+/**
+ * Hands out video frames of one format and size whose plane buffers come from
+ * `AVBufferPool`s, replacing `av_frame_get_buffer` for destination frames
+ * (scaling, filtering, uploads) that are allocated anew for every frame. A
+ * buffer returns to its pool when the last frame referencing it is
+ * unreferenced or freed, so steady-state pipelines allocate nothing.
+ * @note Thread-safe. Buffers still referenced by frames stay valid after the
+ * pool is destroyed.
+ */
+class FramePool
+{
+	const AVPixelFormat _format;
+	const int _width, _height;
+	const size_t _align;
+	int _linesize[4]{};
+	AVBufferPool *_pools[4]{};
+
+public:
+	/**
+	 * @param align Alignment of the plane pointers and line sizes, in bytes
+	 * (see `buffer_alignment()`).
+	 * @throws `av::Error` if the alignment or size is invalid, or the format
+	 * is a hardware format
+	 */
+	FramePool(
+		const AVPixelFormat format,
+		const int width,
+		const int height,
+		const size_t align = 64)
+		: _format{format},
+		  _width{width},
+		  _height{height},
+		  _align{buffer_alignment(align)}
+	{
+		const auto desc = av_pix_fmt_desc_get(format);
+		if (!desc || desc->flags & AV_PIX_FMT_FLAG_HWACCEL)
+			throw Error("av_pix_fmt_desc_get", AVERROR(EINVAL));
+
+		size_t sizes[4];
+		if (const auto rc = image_plane_layout(
+				_linesize, sizes, format, width, height, _align);
+			rc < 0)
+			throw Error("image_plane_layout", rc);
+
+		for (int i = 0; i < 4 && sizes[i]; ++i)
+			// room to align the plane pointer
+			if (!(_pools[i] =
+					  av_buffer_pool_init(sizes[i] + _align - 1, NULL)))
+			{
+				uninit();
+				throw Error("av_buffer_pool_init", AVERROR(ENOMEM));
+			}
+	}
+
+	~FramePool() { uninit(); }
+
+	FramePool(const FramePool &) = delete;
+	FramePool &operator=(const FramePool &) = delete;
+
+	AVPixelFormat format() const { return _format; }
+	int width() const { return _width; }
+	int height() const { return _height; }
+
+	/**
+	 * @return A new frame with pooled buffers and its format and size set.
+	 * @throws `av::Error` if allocation fails
+	 */
+	OwnedFrame get()
+	{
+		OwnedFrame frame;
+		get_buffer(frame);
+		return frame;
+	}
+
+	/**
+	 * Give pooled buffers to a caller-owned frame, e.g. to also reuse the
+	 * `AVFrame` itself. The frame must be blank (freshly allocated or
+	 * unreferenced); its format and size are set.
+	 * @throws `av::Error` if allocation fails
+	 */
+	void get_buffer(AVFrame *const frame)
+	{
+		frame->format = _format;
+		frame->width = _width;
+		frame->height = _height;
+		for (int i = 0; i < 4 && _pools[i]; ++i)
+		{
+			if (!(frame->buf[i] = av_buffer_pool_get(_pools[i])))
+			{
+				av_frame_unref(frame);
+				throw Error("av_buffer_pool_get", AVERROR(ENOMEM));
+			}
+			const auto addr = reinterpret_cast<uintptr_t>(frame->buf[i]->data);
+			frame->data[i] = frame->buf[i]->data + (-addr & (_align - 1));
+			frame->linesize[i] = _linesize[i];
+		}
+		frame->extended_data = frame->data;
+	}
+
+	/**
+	 * @return Whether `frame` has the format and size of this pool's frames,
+	 * e.g. to decide whether the pool must be recreated.
+	 */
+	bool matches(const AVFrame *const frame) const
+	{
+		return frame->format == _format && frame->width == _width &&
+			   frame->height == _height;
+	}
+
+private:
+	void uninit()
+	{
+		for (auto &pool : _pools)
+			av_buffer_pool_uninit(&pool);
+	}
+};
+
+} // namespace av
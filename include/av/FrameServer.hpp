@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <map>
+
+#include "Decoder.hpp"
+#include "Error.hpp"
+#include "KeyframeIndex.hpp"
+#include "MediaReader.hpp"
+#include "Stream.hpp"
+
+extern "C"
+{
+#include <libavutil/frame.h>
+#include <libavutil/mathematics.h>
+}
+
+namespace av
+{
+
+/**
+ * Random access to the decoded frames of one stream by timestamp. A request
+ * seeks to the preceding keyframe and decodes forward to the exact frame; every
+ * frame decoded on the way is kept in an LRU cache bounded by a memory budget,
+ * so stepping backwards through a GOP doesn't re-decode it. Requests slightly
+ * ahead of the last decoded frame continue decoding without seeking.
+ * @warning Do not read from or seek `reader` while it is in use by this class.
+ */
+class FrameServer
+{
+	struct CachedFrame
+	{
+		AVFrame *frame;
+		size_t bytes;
+		std::list<int64_t>::iterator lru;
+		// pts of the frame decoded right after this one, which ends the
+		// interval this frame is presented for; `AV_NOPTS_VALUE` until known
+		int64_t next_pts{AV_NOPTS_VALUE};
+	};
+
+	MediaReader &_reader;
+	const Stream _stream;
+	const KeyframeIndex *const _index;
+	Decoder _decoder;
+
+	std::map<int64_t, CachedFrame> _cache;
+	// most recently used first
+	std::list<int64_t> _lru;
+	size_t _budget, _used{};
+
+	// pts of the last frame received from the decoder, or `AV_NOPTS_VALUE` if
+	// the decoder must be repositioned before the next request
+	int64_t _last_pts{AV_NOPTS_VALUE};
+	bool _eof{};
+
+public:
+	/**
+	 * Open a decoder for `stream`.
+	 * @param reader The reader `stream` belongs to. Must outlive this object.
+	 * @param memory_budget Maximum bytes of frame data kept in the cache.
+	 * @param index Optional index used to seek directly to keyframes. Must
+	 * outlive this object.
+	 * @throws `av::Error` if opening the decoder fails
+	 */
+	FrameServer(
+		MediaReader &reader,
+		const Stream stream,
+		const size_t memory_budget = 256 << 20,
+		const KeyframeIndex *const index = NULL)
+		: _reader{reader},
+		  _stream{stream},
+		  _index{index},
+		  _decoder{stream.create_decoder()},
+		  _budget{memory_budget}
+	{
+		_decoder.copy_params(_stream->codecpar);
+		_decoder->pkt_timebase = _stream->time_base;
+		_decoder.open();
+	}
+
+	~FrameServer() { clear(); }
+
+	FrameServer(const FrameServer &) = delete;
+	FrameServer &operator=(const FrameServer &) = delete;
+
+	/**
+	 * @return The decoder, e.g. to inspect the output format.
+	 */
+	const Decoder &decoder() const { return _decoder; }
+
+	/**
+	 * Get the frame presented at `ts`, i.e. the last frame whose timestamp is
+	 * at or before `ts`.
+	 * @param ts Timestamp in the stream's time base.
+	 * @return The frame, or `NULL` if the stream has no frame at or before
+	 * `ts`.
+	 * @throws `av::Error` if demuxing, seeking or decoding fails
+	 * @warning **Do not free/delete the returned pointer.** It is owned by the
+	 * cache and only valid until the next call.
+	 */
+	const AVFrame *frame_at(const int64_t ts)
+	{
+		if (const auto frame = lookup(ts))
+			return frame;
+		if (!can_decode_forward_to(ts))
+			reposition(ts);
+		return decode_to(ts);
+	}
+
+	/**
+	 * Convenience overload of `frame_at` taking seconds.
+	 */
+	const AVFrame *frame_at_sec(const double seconds)
+	{
+		return frame_at(
+			av_rescale_q(
+				static_cast<int64_t>(seconds * AV_TIME_BASE),
+				AV_TIME_BASE_Q,
+				_stream->time_base));
+	}
+
+	/**
+	 * Drop all cached frames.
+	 */
+	void clear()
+	{
+		for (auto &[_, entry] : _cache)
+			av_frame_free(&entry.frame);
+		_cache.clear();
+		_lru.clear();
+		_used = 0;
+	}
+
+	size_t cached_bytes() const { return _used; }
+
+private:
+	const AVFrame *lookup(const int64_t ts)
+	{
+		auto it = _cache.upper_bound(ts);
+		if (it == _cache.begin())
+			return NULL;
+		--it;
+		const auto &entry = it->second;
+		const auto frame = entry.frame;
+		// durations are often unset (e.g. MPEG-TS), the next pts is not
+		if (ts != it->first &&
+			!(entry.next_pts != AV_NOPTS_VALUE && ts < entry.next_pts) &&
+			!(frame->duration > 0 && ts < it->first + frame->duration))
+			return NULL;
+		_lru.splice(_lru.begin(), _lru, it->second.lru);
+		return frame;
+	}
+
+	bool can_decode_forward_to(const int64_t ts) const
+	{
+		if (_last_pts == AV_NOPTS_VALUE || _eof || ts <= _last_pts)
+			return false;
+		if (_index)
+			return _index->find_keyframe(_stream->index, ts) ==
+				   _index->find_keyframe(_stream->index, _last_pts);
+		// without an index, decoding up to a second ahead beats seeking
+		return ts - _last_pts <=
+			   av_rescale_q(1, AVRational{1, 1}, _stream->time_base);
+	}
+
+	void reposition(const int64_t ts)
+	{
+		if (_index && _index->find_keyframe(_stream->index, ts))
+			_index->seek(_reader, _stream->index, ts);
+		else
+			_reader.seek_file(_stream->index, INT64_MIN, ts, ts, 0);
+		_decoder.flush_buffers();
+		_last_pts = AV_NOPTS_VALUE;
+		_eof = false;
+	}
+
+	const AVFrame *decode_to(const int64_t ts)
+	{
+		// when continuing forward, the last decoded frame may be the answer
+		int64_t prev_pts = _last_pts;
+		const AVFrame *prev{};
+		if (const auto it = _cache.find(prev_pts); it != _cache.end())
+			prev = it->second.frame;
+
+		while (true)
+		{
+			while (const auto frame = _decoder.receive_frame())
+			{
+				const auto pts = frame->best_effort_timestamp;
+				if (pts == AV_NOPTS_VALUE)
+					continue;
+				_last_pts = pts;
+				const auto cached = insert(pts, frame, prev_pts);
+				if (pts > ts)
+					// `ts` falls in the previous frame, or precedes the stream
+					return prev;
+				if (pts == ts ||
+					(frame->duration > 0 && ts < pts + frame->duration))
+					return cached;
+				prev = cached;
+				prev_pts = pts;
+			}
+
+			if (_eof)
+			{
+				// fully drained: the last frame lasts until the end
+				if (const auto it = _cache.find(_last_pts); it != _cache.end())
+					it->second.next_pts = INT64_MAX;
+				return prev;
+			}
+
+			const AVPacket *pkt;
+			while ((pkt = _reader.read_packet()) &&
+				   pkt->stream_index != _stream->index)
+				;
+			if (!pkt)
+				_eof = true;
+			_decoder.send_packet(pkt);
+		}
+	}
+
+	/**
+	 * Reference `frame` into the cache, record it as the successor of the
+	 * frame decoded before it, and evict least recently used frames, sparing
+	 * that frame and the new one, until the budget is met.
+	 * @param prev_pts pts of the frame decoded right before `frame`, or
+	 * `AV_NOPTS_VALUE` after repositioning.
+	 */
+	const AVFrame *insert(
+		const int64_t pts, const AVFrame *const frame, const int64_t prev_pts)
+	{
+		if (prev_pts != AV_NOPTS_VALUE && prev_pts < pts)
+			if (const auto it = _cache.find(prev_pts); it != _cache.end())
+				it->second.next_pts = pts;
+
+		if (const auto it = _cache.find(pts); it != _cache.end())
+		{
+			_lru.splice(_lru.begin(), _lru, it->second.lru);
+			return it->second.frame;
+		}
+
+		const auto clone = av_frame_clone(frame);
+		if (!clone)
+			throw Error("av_frame_clone", AVERROR(ENOMEM));
+		const auto bytes = frame_bytes(clone);
+		_lru.push_front(pts);
+		_cache.emplace(pts, CachedFrame{clone, bytes, _lru.begin()});
+		_used += bytes;
+
+		for (auto it = std::prev(_lru.end());
+			 _used > _budget && it != _lru.begin();)
+		{
+			const auto victim = it--;
+			if (*victim == prev_pts)
+				continue;
+			auto node = _cache.find(*victim);
+			_used -= node->second.bytes;
+			av_frame_free(&node->second.frame);
+			_cache.erase(node);
+			_lru.erase(victim);
+		}
+		return clone;
+	}
+
+	static size_t frame_bytes(const AVFrame *const frame)
+	{
+		size_t bytes{};
+		for (const auto buf : frame->buf)
+			if (buf)
+				bytes += buf->size;
+		for (int i = 0; i < frame->nb_extended_buf; ++i)
+			bytes += frame->extended_buf[i]->size;
+		return bytes;
+	}
+};
+
+} // namespace av
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+
+extern "C"
+{
+#include <libavformat/avio.h>
+#include <libavutil/mem.h>
+}
+
+#include "Error.hpp"
+
+namespace av
+{
+
+/**
+ * Owning wrapper of an `AVIOContext` whose I/O is implemented by a subclass.
+ * Override `read` for input, `write` for output, and `seek` if the underlying
+ * resource supports random access. Pass an instance to `MediaReader` to demux
+ * from it instead of a URL.
+ * @note Subclasses that write must call `flush()` in their own destructor,
+ * since virtual calls no longer reach them from `~IOContext()`.
+ */
+class IOContext
+{
+protected:
+	AVIOContext *_ioctx{};
+
+	/**
+	 * @param buffer_size Size of the internal `AVIOContext` buffer. Reads and
+	 * writes reach `read`/`write` in chunks of at most this many bytes.
+	 * @param write_flag Whether this context is used for writing.
+	 * @throws `av::Error` if allocating the buffer or context fails
+	 */
+	IOContext(const int buffer_size = 32768, const bool write_flag = false)
+	{
+		const auto buffer =
+			static_cast<unsigned char *>(av_malloc(buffer_size));
+		if (!buffer)
+			throw Error("av_malloc", AVERROR(ENOMEM));
+		if (!(_ioctx = avio_alloc_context(
+				  buffer,
+				  buffer_size,
+				  write_flag,
+				  this,
+				  read_callback,
+				  write_callback,
+				  seek_callback)))
+		{
+			av_free(buffer);
+			throw Error("avio_alloc_context", AVERROR(ENOMEM));
+		}
+	}
+
+public:
+	virtual ~IOContext()
+	{
+		if (_ioctx)
+			av_freep(&_ioctx->buffer);
+		avio_context_free(&_ioctx);
+	}
+
+	IOContext(const IOContext &) = delete;
+	IOContext &operator=(const IOContext &) = delete;
+
+	/**
+	 * @return A pointer to the internal `AVIOContext`.
+	 * @warning **Do not free/delete the returned pointer.**
+	 * It belongs to and is managed by this class.
+	 */
+	operator AVIOContext *() const { return _ioctx; }
+	AVIOContext *operator->() const { return _ioctx; }
+
+	/**
+	 * Write out any data buffered in the `AVIOContext`.
+	 */
+	void flush() { avio_flush(_ioctx); }
+
+	/**
+	 * Write out everything buffered, including by the subclass, and report
+	 * any write error. Called by `MediaWriter::write_trailer()`; subclasses
+	 * that buffer or write asynchronously override it, calling this first.
+	 * @throws `av::Error` if a write failed
+	 */
+	virtual void sync()
+	{
+		flush();
+		if (_ioctx->error < 0)
+			throw Error("avio_flush", _ioctx->error);
+	}
+
+	/**
+	 * Fill `buf` with up to `size` bytes from the current position.
+	 * @return The number of bytes read, `AVERROR_EOF` at the end of the
+	 * resource, or another negative `AVERROR` code on failure.
+	 */
+	virtual int read(uint8_t *const, const int) { return AVERROR(ENOSYS); }
+
+	/**
+	 * Write `size` bytes from `buf` at the current position.
+	 * @return The number of bytes written, or a negative `AVERROR` code.
+	 */
+	virtual int write(const uint8_t *const, const int)
+	{
+		return AVERROR(ENOSYS);
+	}
+
+	/**
+	 * @param whence `SEEK_SET`, `SEEK_CUR`, `SEEK_END` or `AVSEEK_SIZE`,
+	 * optionally or'd with `AVSEEK_FORCE`.
+	 * @return The new position, the total size if `whence` is `AVSEEK_SIZE`,
+	 * or a negative `AVERROR` code.
+	 */
+	virtual int64_t seek(const int64_t, const int) { return AVERROR(ENOSYS); }
+
+private:
+	static int read_callback(void *const opaque, uint8_t *const buf, int size)
+	{
+		return static_cast<IOContext *>(opaque)->read(buf, size);
+	}
+
+#if LIBAVFORMAT_VERSION_MAJOR < 61
+	static int write_callback(void *const opaque, uint8_t *const buf, int size)
+#else
+	static int
+	write_callback(void *const opaque, const uint8_t *const buf, int size)
+#endif
+	{
+		return static_cast<IOContext *>(opaque)->write(buf, size);
+	}
+
+	static int64_t
+	seek_callback(void *const opaque, const int64_t offset, const int whence)
+	{
+		return static_cast<IOContext *>(opaque)->seek(offset, whence);
+	}
+};
+
+} // namespace av
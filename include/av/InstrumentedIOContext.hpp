@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+#include "IOContext.hpp"
+#include "UrlIOContext.hpp"
+
+namespace av
+{
+
+/**
+ * Counters recorded by `InstrumentedIOContext`.
+ */
+struct IOStats
+{
+	struct Op
+	{
+		// calls, including failed ones
+		uint64_t count{};
+		uint64_t errors{};
+		// bytes transferred; for seeks, the total distance moved
+		uint64_t bytes{};
+		// wall time spent blocked in the call
+		std::chrono::nanoseconds time{}, max_time{};
+		// `sizes[0]` counts empty transfers, `sizes[i]` those of
+		// `[2^(i-1), 2^i)` bytes (seek distances for seeks)
+		std::array<uint64_t, 40> sizes{};
+	};
+
+	Op reads, writes, seeks;
+	// `AVSEEK_SIZE` queries, which don't move the position
+	uint64_t size_queries{};
+};
+
+/**
+ * `IOContext` decorator that forwards every operation to another `IOContext`
+ * and records byte counts, call counts, size distributions and time spent
+ * blocked, per operation. Pass it to `MediaReader` or `MediaWriter` and read
+ * the counters back with `stats()`, e.g. through
+ * `reader.io<InstrumentedIOContext>()->stats()`, to tune buffer sizes or spot
+ * pathological seek patterns.
+ */
+class InstrumentedIOContext : public IOContext
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::unique_ptr<IOContext> _inner;
+	mutable std::mutex _mtx;
+	IOStats _stats;
+	int64_t _pos{};
+
+public:
+	/**
+	 * Instrument `inner`, taking ownership of it.
+	 * @param buffer_size Size of this context's buffer; calls reach `inner`
+	 * in chunks of at most this many bytes, which is what is measured.
+	 */
+	InstrumentedIOContext(
+		std::unique_ptr<IOContext> inner, const int buffer_size = 32768)
+		: IOContext{buffer_size, (*inner)->write_flag != 0},
+		  _inner{std::move(inner)}
+	{
+	}
+
+	/**
+	 * Instrument I/O on `url`, opened with `avio_open2`.
+	 * @param flags `AVIO_FLAG_READ` and/or `AVIO_FLAG_WRITE`.
+	 * @throws `av::Error` if `avio_open2` fails
+	 */
+	InstrumentedIOContext(
+		const char *const url,
+		const int flags = AVIO_FLAG_READ,
+		const int buffer_size = 32768)
+		: InstrumentedIOContext{
+			  std::make_unique<UrlIOContext>(url, flags), buffer_size}
+	{
+	}
+
+	~InstrumentedIOContext()
+	{
+		// push buffered data to `_inner` before it is destroyed
+		if (_ioctx->write_flag)
+			flush();
+	}
+
+	/**
+	 * @return A snapshot of the counters. Safe to call from any thread, e.g.
+	 * while a `PrefetchReader` is demuxing.
+	 */
+	IOStats stats() const
+	{
+		std::lock_guard lock{_mtx};
+		return _stats;
+	}
+
+	void reset_stats()
+	{
+		std::lock_guard lock{_mtx};
+		_stats = {};
+	}
+
+	IOContext &inner() const { return *_inner; }
+
+	void sync() override
+	{
+		IOContext::sync();
+		_inner->sync();
+	}
+
+	int read(uint8_t *const buf, const int size) override
+	{
+		const auto start = Clock::now();
+		const auto rc = _inner->read(buf, size);
+		// end-of-file is not an error
+		record(_stats.reads, start, rc == AVERROR_EOF ? 0 : rc);
+		if (rc > 0)
+			_pos += rc;
+		return rc;
+	}
+
+	int write(const uint8_t *const buf, const int size) override
+	{
+		const auto start = Clock::now();
+		const auto rc = _inner->write(buf, size);
+		record(_stats.writes, start, rc);
+		if (rc > 0)
+			_pos += rc;
+		return rc;
+	}
+
+	int64_t seek(const int64_t offset, const int whence) override
+	{
+		if (whence & AVSEEK_SIZE)
+		{
+			{
+				std::lock_guard lock{_mtx};
+				++_stats.size_queries;
+			}
+			return _inner->seek(offset, whence);
+		}
+
+		const auto start = Clock::now();
+		const auto rc = _inner->seek(offset, whence);
+		// record the distance moved as the size
+		record(_stats.seeks, start, rc < 0 ? rc : std::abs(rc - _pos));
+		if (rc >= 0)
+			_pos = rc;
+		return rc;
+	}
+
+private:
+	void
+	record(IOStats::Op &op, const Clock::time_point start, const int64_t rc)
+	{
+		const auto elapsed = Clock::now() - start;
+		std::lock_guard lock{_mtx};
+		++op.count;
+		op.time += elapsed;
+		op.max_time = std::max<std::chrono::nanoseconds>(op.max_time, elapsed);
+		if (rc < 0)
+		{
+			++op.errors;
+			return;
+		}
+		op.bytes += rc;
+		const auto bucket = std::bit_width(static_cast<uint64_t>(rc));
+		++op.sizes[std::min<size_t>(bucket, op.sizes.size() - 1)];
+	}
+};
+
+} // namespace av
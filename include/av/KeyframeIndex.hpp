@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "Error.hpp"
+#include "MediaReader.hpp"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+namespace av
+{
+
+/**
+ * Per-stream index of packet timestamps and byte positions, built by scanning
+ * a file once and persisted to a compact binary sidecar file. `seek()` then
+ * jumps straight to the keyframe preceding a timestamp without the demuxer
+ * having to bisect or scan, which matters for index-less formats such as
+ * MPEG-TS and raw streams.
+ *
+ * Sidecar layout (native byte order): the 8-byte magic `AVPPKIDX`, a `uint32_t`
+ * version, a `uint32_t` stream count and the `int64_t` size of the indexed
+ * source, then per stream its time base as two `int32_t`, a `uint64_t` entry
+ * count and that many `Entry` records.
+ */
+class KeyframeIndex
+{
+public:
+	/**
+	 * One demuxed packet, in demux order.
+	 */
+	struct Entry
+	{
+		int64_t pts, dts;
+		// byte position in the source, or `-1` if unknown
+		int64_t pos;
+		// `AV_PKT_FLAG_*`
+		uint32_t flags;
+		uint32_t size;
+
+		bool is_key() const { return flags & AV_PKT_FLAG_KEY; }
+		int64_t ts() const { return pts != AV_NOPTS_VALUE ? pts : dts; }
+	};
+
+	struct StreamIndex
+	{
+		AVRational time_base;
+		std::vector<Entry> entries;
+		// indices into `entries` of keyframes, sorted by `Entry::ts()`
+		std::vector<uint32_t> keyframes;
+	};
+
+	/**
+	 * How `seek()` positions the demuxer.
+	 */
+	enum class SeekMode
+	{
+		// byte seeking for formats with timestamp discontinuities (as ffplay
+		// does) and for formats the demuxer can't seek by timestamp itself,
+		// e.g. raw streams; timestamp seeking otherwise
+		AUTO,
+		BYTE,
+		TIMESTAMP,
+	};
+
+private:
+	static constexpr char MAGIC[8] = {'A', 'V', 'P', 'P', 'K', 'I', 'D', 'X'};
+	static constexpr uint32_t VERSION = 1;
+
+	std::vector<StreamIndex> _streams;
+	int64_t _source_size{-1};
+
+public:
+	/**
+	 * Build an index by demuxing every remaining packet of `reader`. Streams
+	 * whose `discard` is `AVDISCARD_ALL` stay empty.
+	 * @param keyframes_only Only record keyframes, for a smaller sidecar.
+	 * @throws `av::Error` if reading a packet fails
+	 * @note `reader` is left at end-of-file; seek it back before demuxing.
+	 */
+	explicit KeyframeIndex(
+		MediaReader &reader, const bool keyframes_only = false)
+		: _source_size{reader->pb ? avio_size(reader->pb) : -1}
+	{
+		while (const auto pkt = reader.read_packet())
+		{
+			if (keyframes_only && !(pkt->flags & AV_PKT_FLAG_KEY))
+				continue;
+			// streams may be added mid-file by header-less formats
+			add_streams(reader);
+			_streams[pkt->stream_index].entries.push_back({
+				pkt->pts,
+				pkt->dts,
+				pkt->pos,
+				static_cast<uint32_t>(pkt->flags),
+				static_cast<uint32_t>(pkt->size),
+			});
+		}
+
+		add_streams(reader);
+		for (auto &stream : _streams)
+			index_keyframes(stream);
+	}
+
+	/**
+	 * Load an index previously written with `save()`.
+	 * @throws `av::Error` if the file cannot be read, or with
+	 * `AVERROR_INVALIDDATA` if it is not a compatible sidecar
+	 */
+	explicit KeyframeIndex(const char *const sidecar_path)
+	{
+		File f{sidecar_path, "rb"};
+
+		char magic[sizeof MAGIC];
+		uint32_t version, nb_streams;
+		f.read(magic, sizeof magic);
+		f.read(&version, sizeof version);
+		if (std::memcmp(magic, MAGIC, sizeof MAGIC) || version != VERSION)
+			throw Error("KeyframeIndex", AVERROR_INVALIDDATA);
+		f.read(&nb_streams, sizeof nb_streams);
+		f.read(&_source_size, sizeof _source_size);
+
+		// validate counts against the file size before allocating for them
+		// (each stream starts with its time base and entry count)
+		constexpr size_t stream_size = sizeof(AVRational) + sizeof(uint64_t);
+		if (nb_streams > f.remaining() / stream_size)
+			throw Error("KeyframeIndex", AVERROR_INVALIDDATA);
+		_streams.resize(nb_streams);
+		for (auto &stream : _streams)
+		{
+			uint64_t count;
+			f.read(&stream.time_base.num, sizeof stream.time_base.num);
+			f.read(&stream.time_base.den, sizeof stream.time_base.den);
+			f.read(&count, sizeof count);
+			if (count > f.remaining() / sizeof(Entry))
+				throw Error("KeyframeIndex", AVERROR_INVALIDDATA);
+			stream.entries.resize(count);
+			f.read(stream.entries.data(), count * sizeof(Entry));
+			index_keyframes(stream);
+		}
+	}
+
+	/**
+	 * Write this index to a sidecar file, replacing it if it exists.
+	 * @throws `av::Error` if the file cannot be written
+	 */
+	void save(const char *const sidecar_path) const
+	{
+		File f{sidecar_path, "wb"};
+		const uint32_t nb_streams = _streams.size();
+		f.write(MAGIC, sizeof MAGIC);
+		f.write(&VERSION, sizeof VERSION);
+		f.write(&nb_streams, sizeof nb_streams);
+		f.write(&_source_size, sizeof _source_size);
+		for (const auto &stream : _streams)
+		{
+			const uint64_t count = stream.entries.size();
+			f.write(&stream.time_base.num, sizeof stream.time_base.num);
+			f.write(&stream.time_base.den, sizeof stream.time_base.den);
+			f.write(&count, sizeof count);
+			f.write(stream.entries.data(), count * sizeof(Entry));
+		}
+		f.close();
+	}
+
+	/**
+	 * @return The size in bytes of the source this index was built from, or
+	 * `-1` if unknown. Compare against the current source to detect a stale
+	 * sidecar.
+	 */
+	int64_t source_size() const { return _source_size; }
+
+	std::span<const StreamIndex> streams() const { return _streams; }
+
+	/**
+	 * @return The last keyframe of stream `stream_index` whose timestamp is
+	 * at or before `ts`, or `NULL` if there is none.
+	 */
+	const Entry *find_keyframe(const int stream_index, const int64_t ts) const
+	{
+		const auto &stream = _streams.at(stream_index);
+		const auto it = std::upper_bound(
+			stream.keyframes.begin(),
+			stream.keyframes.end(),
+			ts,
+			[&](const int64_t t, const uint32_t i)
+			{ return t < stream.entries[i].ts(); });
+		if (it == stream.keyframes.begin())
+			return NULL;
+		return &stream.entries[*(it - 1)];
+	}
+
+	/**
+	 * Seek `reader` to the keyframe of stream `stream_index` at or before
+	 * `ts`. Flush any decoders fed from `reader` afterwards.
+	 * @param ts Timestamp in the stream's time base.
+	 * @return The keyframe that was seeked to.
+	 * @throws `av::Error` with `AVERROR(ERANGE)` if `ts` precedes the first
+	 * keyframe, or if the seek itself fails
+	 */
+	const Entry &seek(
+		MediaReader &reader,
+		const int stream_index,
+		const int64_t ts,
+		const SeekMode mode = SeekMode::AUTO) const
+	{
+		const auto entry = find_keyframe(stream_index, ts);
+		if (!entry)
+			throw Error("KeyframeIndex::seek", AVERROR(ERANGE));
+
+		if (entry->pos >= 0 && use_byte_seek(reader, mode))
+			reader.seek_frame(stream_index, entry->pos, AVSEEK_FLAG_BYTE);
+		else
+			reader.seek_file(
+				stream_index, INT64_MIN, entry->ts(), entry->ts(), 0);
+		return *entry;
+	}
+
+private:
+	void add_streams(const MediaReader &reader)
+	{
+		while (_streams.size() < reader->nb_streams)
+			_streams.push_back(
+				{reader->streams[_streams.size()]->time_base, {}, {}});
+	}
+
+	static bool use_byte_seek(const MediaReader &reader, const SeekMode mode)
+	{
+		const auto iformat = reader->iformat;
+		if (iformat->flags & AVFMT_NO_BYTE_SEEK)
+			return false;
+		switch (mode)
+		{
+		case SeekMode::BYTE:
+			return true;
+		case SeekMode::TIMESTAMP:
+			return false;
+		default:
+			if (iformat->flags & AVFMT_TS_DISCONT)
+				return std::strcmp(iformat->name, "ogg");
+			// timestamp seeking would fall back to a scan from the start
+			if (iformat->flags & (AVFMT_NOTIMESTAMPS | AVFMT_GENERIC_INDEX))
+				return true;
+#if LIBAVFORMAT_VERSION_MAJOR < 61
+			return !iformat->read_seek && !iformat->read_seek2;
+#else
+			// the seek callbacks are private since libavformat 61
+			return false;
+#endif
+		}
+	}
+
+	static void index_keyframes(StreamIndex &stream)
+	{
+		stream.keyframes.clear();
+		for (uint32_t i = 0; i < stream.entries.size(); ++i)
+			if (stream.entries[i].is_key() &&
+				stream.entries[i].ts() != AV_NOPTS_VALUE)
+				stream.keyframes.push_back(i);
+		std::ranges::stable_sort(
+			stream.keyframes,
+			{},
+			[&](const uint32_t i) { return stream.entries[i].ts(); });
+	}
+
+	// minimal RAII `FILE *` that throws on short reads/writes
+	class File
+	{
+		FILE *_f;
+
+	public:
+		File(const char *const path, const char *const mode)
+			: _f{std::fopen(path, mode)}
+		{
+			if (!_f)
+				throw Error("fopen", AVERROR(errno));
+		}
+
+		~File()
+		{
+			if (_f)
+				std::fclose(_f);
+		}
+
+		// close explicitly to catch errors flushing buffered writes
+		void close()
+		{
+			const int rc = std::fclose(_f);
+			_f = NULL;
+			if (rc)
+				throw Error("fclose", AVERROR(errno));
+		}
+
+		void read(void *const dst, const size_t size)
+		{
+			if (std::fread(dst, 1, size, _f) != size)
+				throw Error(
+					"fread",
+					std::ferror(_f) ? AVERROR(EIO) : AVERROR_INVALIDDATA);
+		}
+
+		// bytes left between the current position and the end of the file
+		uint64_t remaining()
+		{
+			const auto pos = std::ftell(_f);
+			if (pos < 0 || std::fseek(_f, 0, SEEK_END))
+				throw Error("fseek", AVERROR(errno));
+			const auto end = std::ftell(_f);
+			if (end < 0 || std::fseek(_f, pos, SEEK_SET))
+				throw Error("fseek", AVERROR(errno));
+			return end - pos;
+		}
+
+		void write(const void *const src, const size_t size)
+		{
+			if (std::fwrite(src, 1, size, _f) != size)
+				throw Error("fwrite", AVERROR(errno));
+		}
+	};
+};
+
+} // namespace av
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <span>
+#include <vector>
 
 #include "Error.hpp"
 #include "FormatContext.hpp"
+#include "IOContext.hpp"
+#include "MemoryIOContext.hpp"
+#include "Packet.hpp"
 #include "Stream.hpp"
+#include "Util.hpp"
 
 extern "C"
 {
@@ -16,20 +23,66 @@ namespace av
 
 /**
  * A format context in "read" or "input" mode. Fetches stream info automatically
- * into a span, accesible with `streams()`.
+ * (unless disabled through `OpenOptions`) into a span, accesible with
+ * `streams()`.
  */
 class MediaReader : public FormatContext
 {
 	AVPacket *_pkt{};
+	std::unique_ptr<IOContext> _io;
 
 public:
+	/**
+	 * Controls how much work opening an input does. Probing and stream info
+	 * analysis can dominate open latency; tighten or skip them when the
+	 * container is known to be well-formed.
+	 */
+	struct OpenOptions
+	{
+		/**
+		 * Input format to force, skipping format probing. `NULL` to probe.
+		 * @see `av::find_input_format`
+		 */
+		const AVInputFormat *format = NULL;
+
+		/**
+		 * Maximum number of bytes read while probing. `0` keeps FFmpeg's
+		 * default.
+		 */
+		int64_t probesize = 0;
+
+		/**
+		 * Maximum duration, in `AV_TIME_BASE` units, analyzed by
+		 * `avformat_find_stream_info`. `0` keeps FFmpeg's default.
+		 */
+		int64_t analyzeduration = 0;
+
+		/**
+		 * Whether to call `avformat_find_stream_info`. Set to `false` to trust
+		 * the container headers; codec parameters may then be incomplete for
+		 * header-less formats such as MPEG-TS or raw streams.
+		 */
+		bool find_stream_info = true;
+
+		/**
+		 * `AVFormatContext` and demuxer-private options passed to
+		 * `avformat_open_input`. On return, filled with the options that were
+		 * not found. May be `NULL`.
+		 */
+		AVDictionary **options = NULL;
+	};
+
+	/**
+	 * @throws `av::Error` if opening the input or finding stream info fails
+	 */
+	MediaReader(const char *const url, const OpenOptions &opts)
+	{
+		open_input(url, opts);
+	}
+
 	MediaReader(const char *const url)
+		: MediaReader{url, OpenOptions{}}
 	{
-		if (const auto rc = avformat_open_input(&_fmtctx, url, NULL, NULL);
-			rc < 0)
-			throw Error("avformat_open_input", rc);
-		if (const auto rc = avformat_find_stream_info(_fmtctx, NULL); rc < 0)
-			throw Error("avformat_find_stream_info", rc);
 	}
 
 	MediaReader(const std::string &url)
@@ -37,7 +90,72 @@ public:
 	{
 	}
 
-	~MediaReader() { av_packet_free(&_pkt); }
+	/**
+	 * Demux from a custom `IOContext` instead of a URL, e.g. an
+	 * `MmapIOContext`. The reader takes ownership of `io`.
+	 * @throws `av::Error` if opening the input or finding stream info fails
+	 */
+	MediaReader(std::unique_ptr<IOContext> io, const OpenOptions &opts)
+		: _io{std::move(io)}
+	{
+		if (!(_fmtctx = avformat_alloc_context()))
+			throw Error("avformat_alloc_context", AVERROR(ENOMEM));
+		_fmtctx->pb = *_io;
+		open_input(NULL, opts);
+	}
+
+	/**
+	 * @param fmt Input format to force, or `NULL` to probe it from the data.
+	 */
+	MediaReader(
+		std::unique_ptr<IOContext> io, const AVInputFormat *const fmt = NULL)
+		: MediaReader{std::move(io), OpenOptions{.format = fmt}}
+	{
+	}
+
+	/**
+	 * Demux directly from media already in memory, without copying it.
+	 * @param data The media bytes. **Must outlive this reader.**
+	 * @throws `av::Error` if opening the input or finding stream info fails
+	 */
+	MediaReader(const std::span<const std::byte> data, const OpenOptions &opts)
+		: MediaReader{std::make_unique<MemoryIOContext>(data), opts}
+	{
+	}
+
+	/**
+	 * @param format_name Short name of the input format (e.g. `"mp4"`), or
+	 * `NULL` to probe it from the data.
+	 * @throws `av::Error` if the format is unknown
+	 */
+	MediaReader(
+		const std::span<const std::byte> data,
+		const char *const format_name = NULL)
+		: MediaReader{
+			  data,
+			  OpenOptions{
+				  .format =
+					  format_name ? find_input_format(format_name) : NULL}}
+	{
+	}
+
+	~MediaReader()
+	{
+		av_packet_free(&_pkt);
+		// closes the demuxer before `_io` goes away
+		avformat_close_input(&_fmtctx);
+	}
+
+	/**
+	 * @return The custom `IOContext` this reader was created with, if it is a
+	 * `T`, e.g. `io<InstrumentedIOContext>()` to read its counters; `NULL`
+	 * otherwise.
+	 */
+	template <typename T = IOContext>
+	T *io() const
+	{
+		return dynamic_cast<T *>(_io.get());
+	}
 
 	/**
 	 * @returns The streams contained in this media source.
@@ -88,6 +206,65 @@ public:
 		return _fmtctx->streams[idx];
 	}
 
+	/**
+	 * Keep only the streams at `indices`, setting `AVStream::discard` to
+	 * `AVDISCARD_ALL` on every other stream so the demuxer drops their data
+	 * early instead of returning it from `read_packet()`. Streams not
+	 * mentioned in a later call are discarded again.
+	 * @note Some demuxers still return packets of discarded streams; keep
+	 * checking `AVPacket::stream_index`.
+	 * @throws `av::Error` with `AVERROR_STREAM_NOT_FOUND` if an index is out
+	 * of range
+	 */
+	void select_streams(const std::span<const int> indices)
+	{
+		for (const auto i : indices)
+			if (i < 0 || i >= static_cast<int>(_fmtctx->nb_streams))
+				throw Error("select_streams", AVERROR_STREAM_NOT_FOUND);
+		for (const auto s : streams())
+			s->discard = std::ranges::find(indices, s->index) != indices.end()
+							 ? AVDISCARD_DEFAULT
+							 : AVDISCARD_ALL;
+	}
+
+	/**
+	 * Keep only `streams`, e.g. the ones decoders were created for.
+	 */
+	void select_streams(const std::span<const Stream> streams)
+	{
+		std::vector<int> indices;
+		for (const auto s : streams)
+			indices.push_back(s->index);
+		select_streams(indices);
+	}
+
+	/**
+	 * Keep only the streams of media type `type`.
+	 */
+	void select_streams(const AVMediaType type)
+	{
+		for (const auto s : streams())
+			s->discard = s->codecpar->codec_type == type ? AVDISCARD_DEFAULT
+														 : AVDISCARD_ALL;
+	}
+
+	/**
+	 * Keep only the stream at `index`.
+	 */
+	void select_stream(const int index)
+	{
+		select_streams(std::span<const int>{&index, 1});
+	}
+
+	/**
+	 * Undo any previous selection, demuxing every stream again.
+	 */
+	void select_all_streams()
+	{
+		for (const auto s : streams())
+			s->discard = AVDISCARD_DEFAULT;
+	}
+
 	// Wrapper over `av_seek_frame`.
 	void seek_frame(int stream_index, int64_t timestamp, int flags)
 	{
@@ -135,6 +312,59 @@ public:
 			throw Error("av_read_frame", rc);
 		}
 	}
+
+	/**
+	 * Read a packet into a packet from `pool`, which the caller owns, e.g. to
+	 * queue it to another thread.
+	 * @return The packet, or an empty packet if end-of-file has been reached.
+	 */
+	OwnedPacket read_packet(PacketPool &pool)
+	{
+		auto pkt = pool.get();
+		switch (const auto rc = av_read_frame(_fmtctx, pkt))
+		{
+		case 0:
+			return pkt;
+		case AVERROR_EOF:
+			return nullptr;
+		default:
+			throw Error("av_read_frame", rc);
+		}
+	}
+
+	/**
+	 * Non-throwing `read_packet`.
+	 * @return A pointer to the internal `AVPacket`, or the error, which is
+	 * `AVERROR_EOF` at end-of-file.
+	 */
+	Expected<const AVPacket *> try_read_packet()
+	{
+		if (!_pkt && !(_pkt = av_packet_alloc()))
+			return std::unexpected{AVERROR(ENOMEM)};
+		if (const auto rc = av_read_frame(_fmtctx, _pkt); rc < 0)
+			return std::unexpected{rc};
+		return _pkt;
+	}
+
+private:
+	void open_input(const char *const url, const OpenOptions &opts)
+	{
+		if (!_fmtctx && !(_fmtctx = avformat_alloc_context()))
+			throw Error("avformat_alloc_context", AVERROR(ENOMEM));
+		if (opts.probesize)
+			_fmtctx->probesize = opts.probesize;
+		if (opts.analyzeduration)
+			_fmtctx->max_analyze_duration = opts.analyzeduration;
+
+		if (const auto rc =
+				avformat_open_input(&_fmtctx, url, opts.format, opts.options);
+			rc < 0)
+			throw Error("avformat_open_input", rc);
+		if (!opts.find_stream_info)
+			return;
+		if (const auto rc = avformat_find_stream_info(_fmtctx, NULL); rc < 0)
+			throw Error("avformat_find_stream_info", rc);
+	}
 };
 
 } // namespace av
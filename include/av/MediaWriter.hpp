@@ -1,7 +1,10 @@
 #pragma once
 
+#include <memory>
+
 #include "Error.hpp"
 #include "FormatContext.hpp"
+#include "IOContext.hpp"
 #include "Stream.hpp"
 
 extern "C"
@@ -14,6 +17,10 @@ namespace av
 
 struct MediaWriter : FormatContext
 {
+private:
+	std::unique_ptr<IOContext> _io;
+
+public:
 	/**
 	 * @param url URL to write the media file to
 	 * @param oformat format to use for allocating the context, if NULL
@@ -34,6 +41,38 @@ struct MediaWriter : FormatContext
 		}
 	}
 
+	/**
+	 * Mux into a custom `IOContext` instead of opening `url`, e.g. an
+	 * `UringIOContext`. The writer takes ownership of `io`.
+	 * @param filename Used only to guess the output format if `oformat` is
+	 * `NULL`.
+	 * @throws `av::Error` if `avformat_alloc_output_context2` fails
+	 */
+	MediaWriter(
+		std::unique_ptr<IOContext> io,
+		const char *const filename,
+		const AVOutputFormat *const oformat = {})
+		: _io{std::move(io)}
+	{
+		if (const auto rc = avformat_alloc_output_context2(
+				&_fmtctx, oformat, NULL, filename);
+			rc < 0)
+			throw Error("avformat_alloc_output_context2", rc);
+		_fmtctx->pb = *_io;
+		_fmtctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+	}
+
+	/**
+	 * @return The custom `IOContext` this writer was created with, if it is a
+	 * `T`, e.g. `io<InstrumentedIOContext>()` to read its counters; `NULL`
+	 * otherwise.
+	 */
+	template <typename T = IOContext>
+	T *io() const
+	{
+		return dynamic_cast<T *>(_io.get());
+	}
+
 	Stream new_stream(const struct AVCodec *const c = {})
 	{
 		if (const auto stream = avformat_new_stream(_fmtctx, c))
@@ -68,10 +107,27 @@ struct MediaWriter : FormatContext
 			throw Error("av_interleaved_write_frame", rc);
 	}
 
+	/**
+	 * Non-throwing `write_packet`.
+	 */
+	Expected<void> try_write_packet(AVPacket *const pkt)
+	{
+		if (const auto rc = av_interleaved_write_frame(_fmtctx, pkt); rc < 0)
+			return std::unexpected{rc};
+		return {};
+	}
+
+	/**
+	 * Write the trailer and, with a custom `IOContext`, wait until all of the
+	 * data has reached it (see `IOContext::sync()`).
+	 * @throws `av::Error` if writing the trailer or any data failed
+	 */
 	void write_trailer()
 	{
 		if (const auto rc = av_write_trailer(_fmtctx); rc < 0)
 			throw Error("av_write_trailer", rc);
+		if (_io)
+			_io->sync();
 	}
 };
 
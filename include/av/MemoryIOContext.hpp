@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <span>
+
+#include "IOContext.hpp"
+
+namespace av
+{
+
+/**
+ * Read-only, seekable `IOContext` over bytes that are already in memory.
+ * @warning The memory is borrowed, not copied: it must outlive this context
+ * and any `MediaReader` that owns it.
+ */
+class MemoryIOContext : public IOContext
+{
+protected:
+	std::span<const std::byte> _data;
+	int64_t _pos{};
+
+	// For subclasses that provide `_data` after construction.
+	MemoryIOContext(const int buffer_size)
+		: IOContext{buffer_size}
+	{
+	}
+
+public:
+	MemoryIOContext(
+		const std::span<const std::byte> data, const int buffer_size = 32768)
+		: IOContext{buffer_size},
+		  _data{data}
+	{
+	}
+
+	int read(uint8_t *const buf, const int size) override
+	{
+		const auto n = std::min<int64_t>(size, data_size() - _pos);
+		if (n <= 0)
+			return AVERROR_EOF;
+		std::memcpy(buf, _data.data() + _pos, n);
+		_pos += n;
+		return n;
+	}
+
+	int64_t seek(const int64_t offset, const int whence) override
+	{
+		int64_t pos;
+		switch (whence & ~AVSEEK_FORCE)
+		{
+		case AVSEEK_SIZE:
+			return data_size();
+		case SEEK_SET:
+			pos = offset;
+			break;
+		case SEEK_CUR:
+			pos = _pos + offset;
+			break;
+		case SEEK_END:
+			pos = data_size() + offset;
+			break;
+		default:
+			return AVERROR(EINVAL);
+		}
+		if (pos < 0 || pos > data_size())
+			return AVERROR(EINVAL);
+		return _pos = pos;
+	}
+
+private:
+	int64_t data_size() const { return static_cast<int64_t>(_data.size()); }
+};
+
+} // namespace av
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Error.hpp"
+#include "MemoryIOContext.hpp"
+
+namespace av
+{
+
+/**
+ * `MemoryIOContext` over a memory-mapped local file. Reads are served by
+ * copying straight out of the page cache, so the demuxer never issues a
+ * `read()` syscall after the file has been mapped.
+ * @note POSIX only.
+ */
+class MmapIOContext : public MemoryIOContext
+{
+public:
+	/**
+	 * Access pattern hint passed to `madvise` for the whole mapping.
+	 */
+	enum class Advice
+	{
+		NORMAL = MADV_NORMAL,
+		SEQUENTIAL = MADV_SEQUENTIAL,
+		RANDOM = MADV_RANDOM,
+	};
+
+	/**
+	 * Map the file at `path` into memory.
+	 * @param advice Expected access pattern. Use `SEQUENTIAL` for linear
+	 * demuxing and `RANDOM` for seek-heavy workloads such as scrubbing.
+	 * @throws `av::Error` if the file cannot be opened, stat'ed or mapped
+	 */
+	MmapIOContext(
+		const char *const path,
+		const Advice advice = Advice::SEQUENTIAL,
+		const int buffer_size = 32768)
+		: MemoryIOContext{buffer_size}
+	{
+		const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			throw Error("open", AVERROR(errno));
+
+		struct stat st;
+		if (::fstat(fd, &st) < 0)
+		{
+			const int err = errno;
+			::close(fd);
+			throw Error("fstat", AVERROR(err));
+		}
+
+		if (const size_t size = st.st_size)
+		{
+			const auto addr = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr == MAP_FAILED)
+			{
+				const int err = errno;
+				::close(fd);
+				throw Error("mmap", AVERROR(err));
+			}
+			_data = {static_cast<const std::byte *>(addr), size};
+		}
+
+		// the mapping keeps the file alive
+		::close(fd);
+		advise(advice);
+	}
+
+	~MmapIOContext()
+	{
+		if (!_data.empty())
+			::munmap(const_cast<std::byte *>(_data.data()), _data.size());
+	}
+
+	/**
+	 * Change the access pattern hint, e.g. when switching from playback to
+	 * scrubbing.
+	 */
+	void advise(const Advice advice)
+	{
+		if (!_data.empty())
+			::madvise(
+				const_cast<std::byte *>(_data.data()),
+				_data.size(),
+				static_cast<int>(advice));
+	}
+};
+
+} // namespace av
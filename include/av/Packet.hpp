@@ -0,0 +1,289 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "Error.hpp"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace av
+{
+
+/**
+ * Non-owning wrapper class for an `AVPacket *`.
+ * @see `av::Frame`
+ */
+class Packet
+{
+protected:
+	AVPacket *_p{};
+
+public:
+	Packet(AVPacket *const p)
+		: _p{p}
+	{
+	}
+
+	// Provide access to the underlying pointer
+	AVPacket *operator->() const { return _p; }
+	operator AVPacket *() const { return _p; }
+
+	/**
+	 * Make this packet a new reference to the data of `src`.
+	 */
+	void ref(const AVPacket *const src)
+	{
+		if (const auto rc = av_packet_ref(_p, src); rc < 0)
+			throw Error("av_packet_ref", rc);
+	}
+
+	/**
+	 * Take over the reference of `src`, leaving it blank.
+	 */
+	void move_ref(AVPacket *const src) { av_packet_move_ref(_p, src); }
+
+	void unref() { av_packet_unref(_p); }
+};
+
+class PacketPool;
+
+/**
+ * Extension of `Packet` that allocates and then owns its underlying
+ * `AVPacket *`. Packets obtained from a `PacketPool` go back to it instead of
+ * being freed.
+ */
+class OwnedPacket : public Packet
+{
+	friend class PacketPool;
+
+	/**
+	 * Free list shared by a `PacketPool` and its packets, so that packets may
+	 * outlive the pool.
+	 */
+	struct FreeList
+	{
+		std::mutex mtx;
+		std::vector<AVPacket *> packets;
+		const size_t max_packets;
+
+		FreeList(const size_t max_packets)
+			: max_packets{max_packets}
+		{
+		}
+
+		~FreeList()
+		{
+			for (auto &pkt : packets)
+				av_packet_free(&pkt);
+		}
+
+		void put(AVPacket *pkt)
+		{
+			av_packet_unref(pkt);
+			{
+				std::lock_guard lock{mtx};
+				if (packets.size() < max_packets)
+				{
+					packets.push_back(pkt);
+					return;
+				}
+			}
+			av_packet_free(&pkt);
+		}
+	};
+
+	std::shared_ptr<FreeList> _pool;
+
+	OwnedPacket(AVPacket *const p, std::shared_ptr<FreeList> pool)
+		: Packet{p},
+		  _pool{std::move(pool)}
+	{
+	}
+
+public:
+	OwnedPacket()
+		: Packet{av_packet_alloc()}
+	{
+		if (!_p)
+			throw Error("av_packet_alloc", AVERROR(ENOMEM));
+	}
+
+	/**
+	 * An empty (`NULL`) packet, e.g. to signal end-of-file.
+	 */
+	OwnedPacket(std::nullptr_t)
+		: Packet{NULL}
+	{
+	}
+
+	~OwnedPacket() { release(); }
+
+	// Do NOT allow copying an owned packet!
+	OwnedPacket(const OwnedPacket &) = delete;
+	OwnedPacket &operator=(const OwnedPacket &) = delete;
+
+	/**
+	 * Take over the `AVPacket` of `other`, which is left empty (`NULL`) and
+	 * may only be destroyed or assigned to.
+	 */
+	OwnedPacket(OwnedPacket &&other) noexcept
+		: Packet{other._p},
+		  _pool{std::move(other._pool)}
+	{
+		other._p = {};
+	}
+
+	OwnedPacket &operator=(OwnedPacket &&other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			_p = other._p;
+			_pool = std::move(other._pool);
+			other._p = {};
+		}
+		return *this;
+	}
+
+private:
+	void release()
+	{
+		if (!_p)
+			return;
+		if (_pool)
+			_pool->put(_p);
+		else
+			av_packet_free(&_p);
+		_p = {};
+	}
+};
+
+/**
+ * Thread-safe pool of `AVPacket`s, for packets that are queued between
+ * threads (demux -> decode, encode -> mux) and so can't reuse a single
+ * `AVPacket`. Packets return to the pool, unreferenced, when their
+ * `OwnedPacket` is destroyed, and may outlive the pool.
+ */
+class PacketPool
+{
+	std::shared_ptr<OwnedPacket::FreeList> _free;
+
+public:
+	/**
+	 * @param max_free Maximum number of returned packets kept for reuse; any
+	 * more are freed.
+	 */
+	PacketPool(const size_t max_free = 256)
+		: _free{std::make_shared<OwnedPacket::FreeList>(max_free)}
+	{
+	}
+
+	PacketPool(const PacketPool &) = delete;
+	PacketPool &operator=(const PacketPool &) = delete;
+
+	/**
+	 * @return A blank packet, recycled if possible.
+	 * @throws `av::Error` if `av_packet_alloc` fails
+	 */
+	OwnedPacket get()
+	{
+		AVPacket *pkt{};
+		{
+			std::lock_guard lock{_free->mtx};
+			if (!_free->packets.empty())
+			{
+				pkt = _free->packets.back();
+				_free->packets.pop_back();
+			}
+		}
+		if (!pkt && !(pkt = av_packet_alloc()))
+			throw Error("av_packet_alloc", AVERROR(ENOMEM));
+		return {pkt, _free};
+	}
+
+	/**
+	 * @return The number of packets waiting for reuse.
+	 */
+	size_t available() const
+	{
+		std::lock_guard lock{_free->mtx};
+		return _free->packets.size();
+	}
+};
+
+/**
+ * Reusable list of packets for the batch APIs (`Encoder::encode()`). Clearing
+ * the batch only unreferences the packets, so refilling it reuses the same
+ * `AVPacket`s instead of allocating new ones.
+ */
+class PacketBatch
+{
+	std::vector<AVPacket *> _packets;
+	size_t _size{};
+
+public:
+	PacketBatch(const size_t capacity = 0) { _packets.reserve(capacity); }
+
+	~PacketBatch()
+	{
+		for (auto &pkt : _packets)
+			av_packet_free(&pkt);
+	}
+
+	PacketBatch(const PacketBatch &) = delete;
+	PacketBatch &operator=(const PacketBatch &) = delete;
+
+	size_t size() const { return _size; }
+	bool empty() const { return !_size; }
+
+	/**
+	 * The packets currently in the batch, e.g. to pass to
+	 * `Decoder::decode()` or to write with `MediaWriter::write_packet()`.
+	 */
+	std::span<AVPacket *const> packets() const
+	{
+		return {_packets.data(), _size};
+	}
+	auto begin() const { return packets().begin(); }
+	auto end() const { return packets().end(); }
+	AVPacket *operator[](const size_t i) const { return _packets[i]; }
+
+	/**
+	 * Append an empty packet to the batch.
+	 * @return The packet, to be filled by the caller.
+	 * @throws `av::Error` if `av_packet_alloc` fails
+	 */
+	AVPacket *next()
+	{
+		if (_size == _packets.size())
+		{
+			const auto pkt = av_packet_alloc();
+			if (!pkt)
+				throw Error("av_packet_alloc", AVERROR(ENOMEM));
+			_packets.push_back(pkt);
+		}
+		return _packets[_size++];
+	}
+
+	/**
+	 * Remove the last packet, e.g. after failing to fill it.
+	 */
+	void pop_back() { av_packet_unref(_packets[--_size]); }
+
+	/**
+	 * Remove every packet, keeping the `AVPacket`s for reuse.
+	 */
+	void clear()
+	{
+		while (_size)
+			pop_back();
+	}
+};
+
+} // namespace av
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+#include "Decoder.hpp"
+#include "Error.hpp"
+#include "Frame.hpp"
+#include "KeyframeIndex.hpp"
+#include "MediaReader.hpp"
+
+extern "C"
+{
+#include <libavutil/frame.h>
+#include <libavutil/mathematics.h>
+}
+
+namespace av
+{
+
+/**
+ * Decodes one stream of a file with several independent `MediaReader` and
+ * `Decoder` pairs, one per time range, so whole-file analysis scales with the
+ * number of cores. Each range starts at a keyframe (snapped through a
+ * `KeyframeIndex` if one is given, otherwise reached by seeking backwards and
+ * discarding earlier frames), so every frame is delivered exactly once.
+ * Frames without a timestamp are dropped if the stream is split into several
+ * ranges.
+ */
+class ParallelDecoder
+{
+public:
+	struct Options
+	{
+		// number of time ranges; `0` means one per worker thread
+		unsigned nb_segments = 0;
+		// number of worker threads; `0` means one per core
+		unsigned nb_threads = 0;
+		// deliver frames in presentation order on the calling thread, instead
+		// of concurrently from the worker threads as they are decoded
+		bool ordered = true;
+		// decoded frames buffered per range in ordered mode
+		size_t queue_frames = 16;
+		// optional index used to align ranges to keyframes; must outlive
+		// `run()`
+		const KeyframeIndex *index = NULL;
+	};
+
+	/**
+	 * Called for every decoded frame, with `pts` in the stream's time base.
+	 * @warning **Do not free/delete the frame.** It is only valid during the
+	 * call.
+	 */
+	using Callback = std::function<void(const AVFrame *)>;
+
+	/**
+	 * Creates a new, independent reader of the same source for each range.
+	 */
+	using ReaderFactory = std::function<std::unique_ptr<MediaReader>()>;
+
+private:
+	struct Segment
+	{
+		const int64_t begin, end;
+		BoundedQueue<OwnedFrame> queue;
+		std::exception_ptr error;
+
+		Segment(const int64_t begin, const int64_t end, const size_t max_frames)
+			: begin{begin},
+			  end{end},
+			  queue{max_frames}
+		{
+		}
+	};
+
+	const ReaderFactory _open;
+	const Options _opts;
+	int _stream_index;
+	std::vector<std::unique_ptr<Segment>> _segments;
+
+public:
+	/**
+	 * @param open Factory for readers of the source.
+	 * @param stream_index Stream to decode, or `-1` for the best stream of
+	 * `type`.
+	 * @throws `av::Error` if the source can't be opened or has no such stream
+	 */
+	ParallelDecoder(
+		ReaderFactory open,
+		const AVMediaType type,
+		const int stream_index,
+		const Options &opts)
+		: _open{std::move(open)},
+		  _opts{opts}
+	{
+		const auto reader = _open();
+		const auto stream = reader->find_best_stream(type, stream_index);
+		_stream_index = stream->index;
+		split(*reader, stream);
+	}
+
+	ParallelDecoder(
+		ReaderFactory open,
+		const AVMediaType type,
+		const int stream_index = -1)
+		: ParallelDecoder{std::move(open), type, stream_index, Options{}}
+	{
+	}
+
+	/**
+	 * Decode the stream of the media at `url`.
+	 */
+	ParallelDecoder(
+		const std::string &url,
+		const AVMediaType type,
+		const int stream_index,
+		const Options &opts)
+		: ParallelDecoder{
+			  [url] { return std::make_unique<MediaReader>(url); },
+			  type,
+			  stream_index,
+			  opts}
+	{
+	}
+
+	ParallelDecoder(
+		const std::string &url,
+		const AVMediaType type,
+		const int stream_index = -1)
+		: ParallelDecoder{url, type, stream_index, Options{}}
+	{
+	}
+
+	/**
+	 * @return The time ranges `[begin, end)` decoded independently, in the
+	 * stream's time base.
+	 */
+	std::vector<std::pair<int64_t, int64_t>> segments() const
+	{
+		std::vector<std::pair<int64_t, int64_t>> ranges;
+		for (const auto &seg : _segments)
+			ranges.emplace_back(seg->begin, seg->end);
+		return ranges;
+	}
+
+	/**
+	 * Decode the whole stream, invoking `callback` for every frame. In
+	 * unordered mode `callback` is invoked concurrently from the worker
+	 * threads and must be thread-safe.
+	 * @throws `av::Error` (or anything thrown by `callback`) from the first
+	 * failing range; remaining workers are stopped before rethrowing. In
+	 * ordered mode that is the earliest failing range, rethrown after the
+	 * ranges before it were delivered; otherwise it is the first range to
+	 * fail, and the other workers are stopped right away.
+	 */
+	void run(const Callback &callback)
+	{
+		for (auto &seg : _segments)
+		{
+			seg->queue.reset();
+			seg->error = {};
+		}
+
+		std::atomic<size_t> next{};
+		std::atomic<bool> failed{};
+		std::exception_ptr first_error;
+		const auto nb_threads = std::min<size_t>(
+			_opts.nb_threads ? _opts.nb_threads : default_concurrency(),
+			_segments.size());
+
+		std::vector<std::thread> workers;
+		const auto stop = [&]
+		{
+			for (auto &seg : _segments)
+				seg->queue.close();
+			for (auto &t : workers)
+				t.join();
+		};
+
+		for (size_t i = 0; i < nb_threads; ++i)
+			workers.emplace_back(
+				[&]
+				{
+					for (size_t j; !failed && (j = next++) < _segments.size();)
+					{
+						auto &seg = *_segments[j];
+						decode_segment(seg, callback);
+						// unordered: the first failure stops every range, which
+						// the other workers notice on their next frame
+						if (!_opts.ordered && seg.error && !failed.exchange(true))
+						{
+							first_error = seg.error;
+							for (auto &s : _segments)
+								s->queue.close();
+						}
+					}
+				});
+
+		if (!_opts.ordered)
+		{
+			// frames are delivered by the workers; `join()` publishes
+			// `first_error`
+			stop();
+			if (first_error)
+				std::rethrow_exception(first_error);
+			return;
+		}
+
+		try
+		{
+			// in order, drain each range's queue until its worker is done
+			for (auto &seg : _segments)
+			{
+				while (const auto frame = seg->queue.pop())
+					callback(*frame);
+				if (seg->error)
+					std::rethrow_exception(seg->error);
+			}
+		}
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+		stop();
+	}
+
+private:
+	static unsigned default_concurrency()
+	{
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	void split(const MediaReader &reader, const Stream &stream)
+	{
+		const auto tb = stream->time_base;
+		const int64_t start =
+			stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+		int64_t duration = stream->duration;
+		if (duration <= 0 && reader->duration > 0)
+			duration = av_rescale_q(reader->duration, AV_TIME_BASE_Q, tb);
+
+		// without a known duration the stream can't be split
+		unsigned n =
+			_opts.nb_segments ? _opts.nb_segments : default_concurrency();
+		if (duration <= 0)
+			n = 1;
+
+		std::vector<int64_t> bounds{INT64_MIN};
+		for (unsigned i = 1; i < n; ++i)
+		{
+			int64_t b = start + duration * i / n;
+			if (_opts.index)
+			{
+				const auto key = _opts.index->find_keyframe(stream->index, b);
+				if (!key)
+					continue;
+				b = key->ts();
+			}
+			if (b > bounds.back())
+				bounds.push_back(b);
+		}
+		bounds.push_back(INT64_MAX);
+
+		for (size_t i = 0; i + 1 < bounds.size(); ++i)
+			_segments.push_back(std::make_unique<Segment>(
+				bounds[i], bounds[i + 1], _opts.queue_frames));
+	}
+
+	void decode_segment(Segment &seg, const Callback &callback)
+	{
+		try
+		{
+			const auto reader = _open();
+			// the demuxer can drop everything but our stream early
+			reader->select_stream(_stream_index);
+
+			const auto stream = reader->streams()[_stream_index];
+			auto decoder = stream.create_decoder();
+			decoder.copy_params(stream->codecpar);
+			decoder->pkt_timebase = stream->time_base;
+			decoder.open();
+
+			if (seg.begin != INT64_MIN)
+				reader->seek_file(
+					_stream_index, INT64_MIN, seg.begin, seg.begin, 0);
+
+			// a frame without a timestamp can't be assigned to one range, and
+			// would be delivered by every range that decodes it
+			const bool whole = seg.begin == INT64_MIN && seg.end == INT64_MAX;
+
+			bool eof{};
+			while (true)
+			{
+				while (const auto frame = decoder.receive_frame())
+				{
+					const auto pts = frame->best_effort_timestamp;
+					if (pts == AV_NOPTS_VALUE ? !whole : pts < seg.begin)
+						continue;
+					if (pts != AV_NOPTS_VALUE && pts >= seg.end)
+						return seg.queue.close();
+					frame->pts = pts;
+					if (!deliver(seg, frame, callback))
+						return;
+				}
+				if (eof)
+					break;
+
+				const AVPacket *pkt;
+				while ((pkt = reader->read_packet()) &&
+					   pkt->stream_index != _stream_index)
+					;
+				eof = !pkt;
+				decoder.send_packet(pkt);
+			}
+		}
+		catch (...)
+		{
+			seg.error = std::current_exception();
+		}
+		seg.queue.close();
+	}
+
+	/**
+	 * @return `false` if the run is being stopped.
+	 */
+	bool
+	deliver(Segment &seg, const AVFrame *const frame, const Callback &callback)
+	{
+		if (!_opts.ordered)
+		{
+			callback(frame);
+			return !seg.queue.closed();
+		}
+		OwnedFrame ref;
+		if (const auto rc = av_frame_ref(ref, frame); rc < 0)
+			throw Error("av_frame_ref", rc);
+		return seg.queue.push(std::move(ref));
+	}
+};
+
+} // namespace av
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <tuple>
+#include <type_traits>
+
+#if __has_include(<mdspan>)
+#include <mdspan>
+#endif
+
+#include "Error.hpp"
+
+extern "C"
+{
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libavutil/samplefmt.h>
+}
+
+namespace av
+{
+
+/**
+ * Typed, stride-aware view of a 2D plane of elements (pixels, or samples of
+ * interleaved audio), e.g. one plane of an `AVFrame`. Rows may be padded
+ * (`stride` greater than the row size) or flipped (negative `stride`). The
+ * data is never copied.
+ */
+template <typename T>
+class PlaneView
+{
+	using Byte = std::conditional_t<std::is_const_v<T>, const uint8_t, uint8_t>;
+
+	T *_data;
+	size_t _width, _height;
+	ptrdiff_t _stride;
+
+public:
+	using value_type = T;
+
+	/**
+	 * @param stride Distance between the starts of two rows, in bytes.
+	 */
+	PlaneView(
+		T *const data,
+		const size_t width,
+		const size_t height,
+		const ptrdiff_t stride)
+		: _data{data},
+		  _width{width},
+		  _height{height},
+		  _stride{stride}
+	{
+	}
+
+	// a mutable view converts to a read-only one
+	template <typename U>
+		requires std::is_same_v<const U, T>
+	PlaneView(const PlaneView<U> &other)
+		: PlaneView{other.data(), other.width(), other.height(), other.stride()}
+	{
+	}
+
+	T *data() const { return _data; }
+	size_t width() const { return _width; }
+	size_t height() const { return _height; }
+	ptrdiff_t stride() const { return _stride; }
+
+	/**
+	 * @return Whether the rows follow each other without padding, i.e. the
+	 * plane can be used as one packed buffer.
+	 */
+	bool contiguous() const
+	{
+		return _stride == static_cast<ptrdiff_t>(_width * sizeof(T));
+	}
+
+	std::span<T> row(const size_t y) const
+	{
+		const auto begin = reinterpret_cast<Byte *>(_data) +
+						   static_cast<ptrdiff_t>(y) * _stride;
+		return {reinterpret_cast<T *>(begin), _width};
+	}
+
+	T &operator[](const size_t y, const size_t x) const { return row(y)[x]; }
+
+	/**
+	 * Copy the plane to a tightly-packed buffer of `width() * height()`
+	 * elements.
+	 * @throws `av::Error` if `dst` is too small
+	 */
+	void copy_to(const std::span<std::remove_const_t<T>> dst) const
+	{
+		if (dst.size() < _width * _height)
+			throw Error("PlaneView::copy_to", AVERROR(EINVAL));
+		if (contiguous())
+		{
+			std::memcpy(dst.data(), _data, _width * _height * sizeof(T));
+			return;
+		}
+		for (size_t y = 0; y < _height; ++y)
+			std::ranges::copy(row(y), dst.begin() + y * _width);
+	}
+
+#ifdef __cpp_lib_mdspan
+	/**
+	 * @return The plane as a `std::mdspan` indexed `[y, x]`. Only available
+	 * for element types whose size is a power of two, since libav line sizes
+	 * are not multiples of e.g. 3 (`PixelRGB`); use `row()` for those.
+	 * @throws `av::Error` if the stride is not positive or not a multiple of
+	 * `sizeof(T)`
+	 */
+	auto mdspan() const
+		requires(std::has_single_bit(sizeof(T)))
+	{
+		if (_stride <= 0 || _stride % static_cast<ptrdiff_t>(sizeof(T)))
+			throw Error("PlaneView::mdspan", AVERROR(EINVAL));
+		using Extents = std::dextents<size_t, 2>;
+		const std::layout_stride::mapping<Extents> mapping{
+			Extents{_height, _width},
+			std::array<size_t, 2>{_stride / sizeof(T), 1}};
+		return std::mdspan<T, Extents, std::layout_stride>{_data, mapping};
+	}
+#endif
+};
+
+/**
+ * Pixel types of packed formats, and of interleaved chroma planes.
+ */
+struct PixelRGBA
+{
+	uint8_t r, g, b, a;
+};
+
+struct PixelBGRA
+{
+	uint8_t b, g, r, a;
+};
+
+struct PixelRGB
+{
+	uint8_t r, g, b;
+};
+
+struct PixelUV
+{
+	uint8_t u, v;
+};
+
+/**
+ * Layout of a pixel format with the element type of each plane. Plane 0 is
+ * full size; the others are subsampled by `2^log2_chroma_w` horizontally and
+ * `2^log2_chroma_h` vertically.
+ */
+template <int Log2ChromaW, int Log2ChromaH, typename... Planes>
+struct PixelLayout
+{
+	using planes = std::tuple<Planes...>;
+	static constexpr size_t nb_planes = sizeof...(Planes);
+	static constexpr int log2_chroma_w = Log2ChromaW;
+	static constexpr int log2_chroma_h = Log2ChromaH;
+
+	/**
+	 * @return The width of plane `i` of a frame `width` pixels wide.
+	 */
+	static constexpr int plane_width(const size_t i, const int width)
+	{
+		// round up, like `AV_CEIL_RSHIFT`
+		return i ? -(-width >> log2_chroma_w) : width;
+	}
+
+	/**
+	 * @return The height of plane `i` of a frame `height` pixels high.
+	 */
+	static constexpr int plane_height(const size_t i, const int height)
+	{
+		return i ? -(-height >> log2_chroma_h) : height;
+	}
+};
+
+/**
+ * Compile-time layout of a pixel format, for `plane_view()`. Only defined
+ * for supported formats.
+ */
+template <AVPixelFormat Fmt>
+struct PixelTraits;
+
+template <>
+struct PixelTraits<AV_PIX_FMT_RGBA> : PixelLayout<0, 0, PixelRGBA>
+{
+};
+
+template <>
+struct PixelTraits<AV_PIX_FMT_BGRA> : PixelLayout<0, 0, PixelBGRA>
+{
+};
+
+template <>
+struct PixelTraits<AV_PIX_FMT_RGB24> : PixelLayout<0, 0, PixelRGB>
+{
+};
+
+template <>
+struct PixelTraits<AV_PIX_FMT_GRAY8> : PixelLayout<0, 0, uint8_t>
+{
+};
+
+template <>
+struct PixelTraits<AV_PIX_FMT_YUV420P>
+	: PixelLayout<1, 1, uint8_t, uint8_t, uint8_t>
+{
+};
+
+template <>
+struct PixelTraits<AV_PIX_FMT_YUV422P>
+	: PixelLayout<1, 0, uint8_t, uint8_t, uint8_t>
+{
+};
+
+template <>
+struct PixelTraits<AV_PIX_FMT_YUV444P>
+	: PixelLayout<0, 0, uint8_t, uint8_t, uint8_t>
+{
+};
+
+template <>
+struct PixelTraits<AV_PIX_FMT_NV12> : PixelLayout<1, 1, uint8_t, PixelUV>
+{
+};
+
+/**
+ * @return A view of plane `I` of `frame`, typed for the pixel format `Fmt`.
+ * @throws `av::Error` if `frame` is not in the format `Fmt`
+ */
+template <AVPixelFormat Fmt, size_t I>
+	requires(I < PixelTraits<Fmt>::nb_planes)
+PlaneView<std::tuple_element_t<I, typename PixelTraits<Fmt>::planes>>
+plane_view(AVFrame *const frame)
+{
+	using Traits = PixelTraits<Fmt>;
+	using T = std::tuple_element_t<I, typename Traits::planes>;
+	if (frame->format != Fmt)
+		throw Error("plane_view", AVERROR(EINVAL));
+	return {
+		reinterpret_cast<T *>(frame->data[I]),
+		static_cast<size_t>(Traits::plane_width(I, frame->width)),
+		static_cast<size_t>(Traits::plane_height(I, frame->height)),
+		frame->linesize[I]};
+}
+
+/**
+ * Read-only `plane_view()` of a const frame.
+ */
+template <AVPixelFormat Fmt, size_t I>
+	requires(I < PixelTraits<Fmt>::nb_planes)
+PlaneView<const std::tuple_element_t<I, typename PixelTraits<Fmt>::planes>>
+plane_view(const AVFrame *const frame)
+{
+	return plane_view<Fmt, I>(const_cast<AVFrame *>(frame));
+}
+
+/**
+ * Layout of a sample format.
+ */
+template <typename T, bool Planar>
+struct SampleLayout
+{
+	using sample = T;
+	static constexpr bool planar = Planar;
+};
+
+/**
+ * Compile-time layout of a sample format, for `channel_view()` and
+ * `sample_view()`.
+ */
+template <AVSampleFormat Fmt>
+struct SampleTraits;
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_U8> : SampleLayout<uint8_t, false>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_S16> : SampleLayout<int16_t, false>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_S32> : SampleLayout<int32_t, false>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_FLT> : SampleLayout<float, false>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_DBL> : SampleLayout<double, false>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_U8P> : SampleLayout<uint8_t, true>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_S16P> : SampleLayout<int16_t, true>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_S32P> : SampleLayout<int32_t, true>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_FLTP> : SampleLayout<float, true>
+{
+};
+
+template <>
+struct SampleTraits<AV_SAMPLE_FMT_DBLP> : SampleLayout<double, true>
+{
+};
+
+/**
+ * @return The samples of channel `ch` of a planar audio `frame`.
+ * @throws `av::Error` if `frame` is not in the format `Fmt` or has no channel
+ * `ch`
+ */
+template <AVSampleFormat Fmt>
+	requires SampleTraits<Fmt>::planar
+std::span<typename SampleTraits<Fmt>::sample>
+channel_view(AVFrame *const frame, const int ch)
+{
+	using T = typename SampleTraits<Fmt>::sample;
+	if (frame->format != Fmt || ch < 0 || ch >= frame->ch_layout.nb_channels)
+		throw Error("channel_view", AVERROR(EINVAL));
+	return {
+		reinterpret_cast<T *>(frame->extended_data[ch]),
+		static_cast<size_t>(frame->nb_samples)};
+}
+
+/**
+ * Read-only `channel_view()` of a const frame.
+ */
+template <AVSampleFormat Fmt>
+	requires SampleTraits<Fmt>::planar
+std::span<const typename SampleTraits<Fmt>::sample>
+channel_view(const AVFrame *const frame, const int ch)
+{
+	return channel_view<Fmt>(const_cast<AVFrame *>(frame), ch);
+}
+
+/**
+ * @return The samples of an interleaved audio `frame`, indexed
+ * `[sample, channel]`.
+ * @throws `av::Error` if `frame` is not in the format `Fmt`
+ */
+template <AVSampleFormat Fmt>
+	requires(!SampleTraits<Fmt>::planar)
+PlaneView<typename SampleTraits<Fmt>::sample>
+sample_view(AVFrame *const frame)
+{
+	using T = typename SampleTraits<Fmt>::sample;
+	if (frame->format != Fmt)
+		throw Error("sample_view", AVERROR(EINVAL));
+	const size_t channels = frame->ch_layout.nb_channels;
+	return {
+		reinterpret_cast<T *>(frame->data[0]),
+		channels,
+		static_cast<size_t>(frame->nb_samples),
+		static_cast<ptrdiff_t>(channels * sizeof(T))};
+}
+
+/**
+ * Read-only `sample_view()` of a const frame.
+ */
+template <AVSampleFormat Fmt>
+	requires(!SampleTraits<Fmt>::planar)
+PlaneView<const typename SampleTraits<Fmt>::sample>
+sample_view(const AVFrame *const frame)
+{
+	return sample_view<Fmt>(const_cast<AVFrame *>(frame));
+}
+
+} // namespace av
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <exception>
+#include <thread>
+
+#include "BoundedQueue.hpp"
+#include "Error.hpp"
+#include "MediaReader.hpp"
+#include "Packet.hpp"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+namespace av
+{
+
+/**
+ * Demuxes a `MediaReader` on a dedicated thread into a bounded queue of
+ * ref-counted packets, so that I/O stalls overlap with decoding instead of
+ * blocking it. Packets are moved into the queue, never copied, and recycled
+ * through a `PacketPool`.
+ * @warning While a `PrefetchReader` exists, do not call `read_packet()` or
+ * seek on the underlying `MediaReader` directly; use this class instead.
+ */
+class PrefetchReader
+{
+public:
+	/**
+	 * Read-ahead budget. The demux thread blocks once either limit is
+	 * reached, until the caller consumes packets.
+	 */
+	struct Limits
+	{
+		size_t max_packets = 256;
+		size_t max_bytes = 64 << 20;
+	};
+
+private:
+	MediaReader &_reader;
+	PacketPool _pool;
+	BoundedQueue<OwnedPacket> _queue;
+	OwnedPacket _pkt{nullptr};
+	std::exception_ptr _error;
+	std::thread _thread;
+
+public:
+	/**
+	 * Start prefetching from the current position of `reader`.
+	 * @param reader The reader to demux from. Must outlive this object.
+	 */
+	PrefetchReader(MediaReader &reader, const Limits &limits)
+		: _reader{reader},
+		  _pool{limits.max_packets + 1},
+		  _queue{limits.max_packets, limits.max_bytes}
+	{
+		start();
+	}
+
+	PrefetchReader(MediaReader &reader)
+		: PrefetchReader{reader, Limits{}}
+	{
+	}
+
+	~PrefetchReader() { stop(); }
+
+	PrefetchReader(const PrefetchReader &) = delete;
+	PrefetchReader &operator=(const PrefetchReader &) = delete;
+
+	/**
+	 * Same contract as `MediaReader::read_packet()`, but served from the
+	 * prefetch queue. Blocks only if the demux thread has fallen behind.
+	 * @return A pointer to the current packet, valid until the next call, or
+	 * `NULL` if end-of-file has been reached.
+	 * @throws `av::Error` (or any other exception) raised on the demux thread
+	 */
+	const AVPacket *read_packet()
+	{
+		auto pkt = _queue.pop();
+		if (!pkt)
+		{
+			if (_error)
+				std::rethrow_exception(_error);
+			return NULL;
+		}
+		_pkt = std::move(*pkt);
+		return _pkt;
+	}
+
+	/**
+	 * Stop the demux thread, drop everything prefetched, seek the underlying
+	 * reader with `MediaReader::seek_file` and resume prefetching.
+	 * @throws `av::Error` if seeking fails; prefetching then resumes from
+	 * wherever the reader was left
+	 */
+	void seek_file(
+		int stream_index, int64_t min_ts, int64_t ts, int64_t max_ts, int flags)
+	{
+		stop();
+		_queue.reset();
+		_error = {};
+		try
+		{
+			_reader.seek_file(stream_index, min_ts, ts, max_ts, flags);
+		}
+		catch (...)
+		{
+			// never leave the queue without a producer
+			start();
+			throw;
+		}
+		start();
+	}
+
+private:
+	void start() { _thread = std::thread{&PrefetchReader::run, this}; }
+
+	void stop()
+	{
+		_queue.close();
+		if (_thread.joinable())
+			_thread.join();
+	}
+
+	void run()
+	{
+		try
+		{
+			while (true)
+			{
+				auto pkt = _reader.read_packet(_pool);
+				if (!pkt)
+					break;
+				const size_t size = pkt->size;
+				if (!_queue.push(std::move(pkt), size))
+					return;
+			}
+		}
+		catch (...)
+		{
+			_error = std::current_exception();
+		}
+		_queue.close();
+	}
+};
+
+} // namespace av
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "BitstreamFilter.hpp"
+#include "Error.hpp"
+#include "MediaReader.hpp"
+#include "MediaWriter.hpp"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+namespace av
+{
+
+/**
+ * Copies streams from a `MediaReader` to a `MediaWriter` without decoding,
+ * e.g. to rewrap MKV or MPEG-TS into MP4. Output streams are created from the
+ * input streams' codec parameters, timestamps are rescaled to the output time
+ * bases and ref-counted packets are moved into the muxer, so payloads are
+ * never copied. Bitstream filters can be applied per stream.
+ */
+class Remuxer
+{
+public:
+	struct Options
+	{
+		// input stream indices to copy; empty copies every audio, video and
+		// subtitle stream
+		std::vector<int> streams;
+		// bitstream filters by input stream index, in the syntax of
+		// `av_bsf_list_parse_str` (e.g. `"h264_mp4toannexb"`)
+		std::map<int, std::string> bsfs;
+	};
+
+	struct Stats
+	{
+		size_t packets{};
+		size_t bytes{};
+	};
+
+private:
+	struct Mapping
+	{
+		int output_index = -1;
+		AVRational time_base{};
+		std::optional<BitstreamFilter> bsf;
+	};
+
+	MediaReader &_reader;
+	MediaWriter &_writer;
+	// indexed by input stream index
+	std::vector<Mapping> _map;
+	AVPacket *_pkt{};
+	Stats _stats;
+
+public:
+	/**
+	 * Create the output streams of `writer` for the selected streams of
+	 * `reader`; streams that are not copied are discarded in the demuxer.
+	 * @param reader Must outlive this object.
+	 * @param writer Must outlive this object, and have no header written yet.
+	 * @throws `av::Error` if a stream or bitstream filter can't be set up
+	 */
+	Remuxer(MediaReader &reader, MediaWriter &writer, const Options &opts)
+		: _reader{reader},
+		  _writer{writer},
+		  _map(reader->nb_streams)
+	{
+		map_streams(opts);
+		if (!(_pkt = av_packet_alloc()))
+			throw Error("av_packet_alloc", AVERROR(ENOMEM));
+	}
+
+	Remuxer(MediaReader &reader, MediaWriter &writer)
+		: Remuxer{reader, writer, Options{}}
+	{
+	}
+
+	~Remuxer() { av_packet_free(&_pkt); }
+
+	Remuxer(const Remuxer &) = delete;
+	Remuxer &operator=(const Remuxer &) = delete;
+
+	/**
+	 * @return The output stream index that input stream `input_index` is
+	 * copied to, or `-1` if it is not copied.
+	 */
+	int output_index(const int input_index) const
+	{
+		return _map.at(input_index).output_index;
+	}
+
+	/**
+	 * Write the header, copy every remaining packet of the reader and write
+	 * the trailer.
+	 * @param options Muxer options passed to `MediaWriter::write_header`.
+	 * @return Counts of the packets and payload bytes written.
+	 * @throws `av::Error` if demuxing, filtering or muxing fails
+	 */
+	const Stats &run(AVDictionary **const options = NULL)
+	{
+		_writer.write_header(options);
+
+		while (true)
+		{
+			if (const auto rc = av_read_frame(_reader, _pkt); rc < 0)
+			{
+				if (rc == AVERROR_EOF)
+					break;
+				throw Error("av_read_frame", rc);
+			}
+			if (_pkt->stream_index >= static_cast<int>(_map.size()) ||
+				_map[_pkt->stream_index].output_index < 0)
+			{
+				av_packet_unref(_pkt);
+				continue;
+			}
+			auto &m = _map[_pkt->stream_index];
+			if (m.bsf)
+				filter(m, _pkt);
+			else
+				write(m, _pkt);
+		}
+
+		// drain packets buffered in the bitstream filters
+		for (auto &m : _map)
+			if (m.bsf)
+				filter(m, NULL);
+
+		_writer.write_trailer();
+		return _stats;
+	}
+
+	const Stats &stats() const { return _stats; }
+
+private:
+	void map_streams(const Options &opts)
+	{
+		std::vector<int> selected = opts.streams;
+		if (selected.empty())
+			for (const auto s : _reader.streams())
+				switch (s->codecpar->codec_type)
+				{
+				case AVMEDIA_TYPE_AUDIO:
+				case AVMEDIA_TYPE_VIDEO:
+				case AVMEDIA_TYPE_SUBTITLE:
+					selected.push_back(s->index);
+				default:;
+				}
+		_reader.select_streams(selected);
+
+		for (const auto i : selected)
+		{
+			const Stream ist = _reader->streams[i];
+			auto &m = _map[i];
+			const AVCodecParameters *par = ist->codecpar;
+			m.time_base = ist->time_base;
+
+			if (const auto it = opts.bsfs.find(i); it != opts.bsfs.end())
+			{
+				auto &bsf = m.bsf.emplace(it->second.c_str(), ist);
+				par = bsf->par_out;
+				m.time_base = bsf->time_base_out;
+			}
+
+			auto ost = _writer.new_stream();
+			ost.copy_params(par);
+			// tags are container specific; let the muxer choose its own
+			ost->codecpar->codec_tag = 0;
+			// a hint only, the muxer may change it in `write_header`
+			ost->time_base = m.time_base;
+			m.output_index = ost->index;
+		}
+	}
+
+	/**
+	 * Send `pkt` (or `NULL` to drain) through the bitstream filter of `m` and
+	 * write everything it outputs.
+	 */
+	void filter(Mapping &m, AVPacket *const pkt)
+	{
+		// output is drained after every packet, so input is always accepted
+		m.bsf->send_packet(pkt);
+		while (const auto out = m.bsf->receive_packet())
+			write(m, out);
+	}
+
+	void write(const Mapping &m, AVPacket *const pkt)
+	{
+		_stats.packets++;
+		_stats.bytes += pkt->size;
+		pkt->stream_index = m.output_index;
+		av_packet_rescale_ts(
+			pkt, m.time_base, _writer->streams[m.output_index]->time_base);
+		pkt->pos = -1;
+		// takes ownership of the packet's reference and leaves it blank
+		_writer.write_packet(pkt);
+	}
+};
+
+} // namespace av
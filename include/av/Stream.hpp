@@ -111,6 +111,16 @@ public:
 			rc < 0)
 			throw Error("avcodec_parameters_from_context", rc);
 	}
+
+	/**
+	 * Copy codec parameters directly, e.g. from an input stream when
+	 * remuxing without decoding.
+	 */
+	void copy_params(const AVCodecParameters *const par)
+	{
+		if (const auto rc = avcodec_parameters_copy(_s->codecpar, par); rc < 0)
+			throw Error("avcodec_parameters_copy", rc);
+	}
 };
 
 } // namespace av
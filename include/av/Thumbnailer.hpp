@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Decoder.hpp"
+#include "Error.hpp"
+#include "Frame.hpp"
+#include "MediaReader.hpp"
+#include "Scaler.hpp"
+
+extern "C"
+{
+#include <libavutil/mathematics.h>
+}
+
+namespace av
+{
+
+/**
+ * Extracts thumbnails by seeking to each requested timestamp and decoding only
+ * the preceding keyframe (`skip_frame = AVDISCARD_NONKEY`, non-key packets are
+ * never even sent to the decoder), optionally at reduced resolution through
+ * `lowres`, then scaling it straight to the target size. Requests, across any
+ * number of files, are processed in parallel.
+ */
+class Thumbnailer
+{
+public:
+	struct Options
+	{
+		// target width; `0` derives it from `height` keeping the aspect ratio
+		int width = 320;
+		// target height; `0` derives it from `width` keeping the aspect ratio
+		int height = 0;
+		AVPixelFormat format = AV_PIX_FMT_RGBA;
+		// decode at 1/2^lowres resolution, if the decoder supports it
+		int lowres = 0;
+		int sws_flags = SWS_BILINEAR;
+		// `0` means one per core
+		unsigned nb_threads = 0;
+	};
+
+	struct Request
+	{
+		std::string url;
+		double seconds;
+	};
+
+	/**
+	 * Called with the index of the request and its thumbnail, whose `pts` is
+	 * that of the keyframe it was decoded from. Called concurrently from the
+	 * worker threads; must be thread-safe.
+	 * @warning **Do not free/delete the frame.** It is only valid during the
+	 * call.
+	 */
+	using Callback = std::function<void(size_t, const AVFrame *)>;
+
+private:
+	// per-worker state, reused while consecutive requests hit the same url
+	struct Context
+	{
+		std::string url;
+		std::unique_ptr<MediaReader> reader;
+		std::optional<Stream> stream;
+		std::optional<Decoder> decoder;
+		std::optional<Scaler> scaler;
+		int src_width{}, src_height{}, src_format{AV_PIX_FMT_NONE};
+		int dst_width{}, dst_height{};
+		OwnedFrame thumb;
+	};
+
+	const Options _opts;
+
+public:
+	Thumbnailer(const Options &opts)
+		: _opts{opts}
+	{
+	}
+
+	Thumbnailer()
+		: Thumbnailer{Options{}}
+	{
+	}
+
+	/**
+	 * @return `count` requests evenly spaced over the duration of the media at
+	 * `url`, at the centers of equal intervals.
+	 * @throws `av::Error` if the media can't be opened
+	 */
+	static std::vector<Request>
+	evenly_spaced(const std::string &url, const unsigned count)
+	{
+		const MediaReader reader{url};
+		const auto duration = reader->duration > 0
+								  ? reader->duration / (double)AV_TIME_BASE
+								  : 0.0;
+		std::vector<Request> requests;
+		for (unsigned i = 0; i < count; ++i)
+			requests.push_back({url, duration * (i + 0.5) / count});
+		return requests;
+	}
+
+	/**
+	 * Produce a thumbnail for every request.
+	 * @throws `av::Error` from the first failing request; pending requests are
+	 * abandoned
+	 */
+	void run(const std::span<const Request> requests, const Callback &callback)
+	{
+		std::atomic<size_t> next{};
+		std::exception_ptr error;
+		std::mutex error_mtx;
+
+		const auto work = [&]
+		{
+			Context ctx;
+			for (size_t i; (i = next++) < requests.size();)
+				try
+				{
+					extract(ctx, requests[i], i, callback);
+				}
+				catch (...)
+				{
+					std::lock_guard lock{error_mtx};
+					if (!error)
+						error = std::current_exception();
+					next = requests.size();
+				}
+		};
+
+		const auto nb_threads = std::min<size_t>(
+			_opts.nb_threads
+				? _opts.nb_threads
+				: std::max(1u, std::thread::hardware_concurrency()),
+			requests.size());
+		std::vector<std::jthread> workers;
+		for (size_t i = 0; i < nb_threads; ++i)
+			workers.emplace_back(work);
+		workers.clear();
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+private:
+	void open(Context &ctx, const std::string &url) const
+	{
+		ctx.scaler.reset();
+		ctx.decoder.reset();
+		ctx.stream.reset();
+		ctx.reader = std::make_unique<MediaReader>(url);
+		ctx.url = url;
+
+		const AVCodec *codec{};
+		ctx.stream = ctx.reader->find_best_stream(
+			AVMEDIA_TYPE_VIDEO, -1, -1, &codec);
+		ctx.reader->select_stream((*ctx.stream)->index);
+
+		auto &decoder = ctx.decoder.emplace(codec);
+		decoder.copy_params((*ctx.stream)->codecpar);
+		decoder->pkt_timebase = (*ctx.stream)->time_base;
+		decoder.set_quality(
+			{.skip_frame = AVDISCARD_NONKEY, .lowres = _opts.lowres});
+		// parallelism comes from the workers; frame threading only adds delay
+		decoder.set_threading(CodecContext::Threading::NONE);
+		decoder.open();
+	}
+
+	void extract(
+		Context &ctx,
+		const Request &req,
+		const size_t i,
+		const Callback &callback) const
+	{
+		if (!ctx.reader || ctx.url != req.url)
+			open(ctx, req.url);
+		auto &reader = *ctx.reader;
+		auto &decoder = *ctx.decoder;
+		const auto &stream = *ctx.stream;
+
+		auto ts = av_rescale_q(
+			static_cast<int64_t>(req.seconds * AV_TIME_BASE),
+			AV_TIME_BASE_Q,
+			stream->time_base);
+		if (stream->start_time != AV_NOPTS_VALUE)
+			ts += stream->start_time;
+		reader.seek_file(stream->index, INT64_MIN, ts, ts, 0);
+
+		while (const auto pkt = reader.read_packet())
+		{
+			if (pkt->stream_index != stream->index ||
+				!(pkt->flags & AV_PKT_FLAG_KEY))
+				continue;
+			// drain right after the keyframe instead of waiting on the
+			// decoder's reordering delay
+			decoder.flush_buffers();
+			decoder.send_packet(pkt);
+			decoder.send_packet(NULL);
+			if (const auto frame = decoder.receive_frame())
+			{
+				callback(i, scale(ctx, frame));
+				ctx.thumb.unref();
+				return;
+			}
+		}
+		throw Error("Thumbnailer", AVERROR_EOF);
+	}
+
+	const AVFrame *scale(Context &ctx, const AVFrame *const src) const
+	{
+		if (!ctx.scaler || src->width != ctx.src_width ||
+			src->height != ctx.src_height || src->format != ctx.src_format)
+		{
+			auto w = _opts.width, h = _opts.height;
+			if (!w && !h)
+				w = src->width, h = src->height;
+			else if (!h)
+				h = std::max(2, (w * src->height / src->width) & ~1);
+			else if (!w)
+				w = std::max(2, (h * src->width / src->height) & ~1);
+
+			ctx.scaler.reset();
+			ctx.scaler.emplace(
+				Scaler::SrcDstArgs{
+					static_cast<uint32_t>(src->width),
+					static_cast<uint32_t>(src->height),
+					static_cast<AVPixelFormat>(src->format)},
+				Scaler::SrcDstArgs{
+					static_cast<uint32_t>(w),
+					static_cast<uint32_t>(h),
+					_opts.format},
+				_opts.sws_flags);
+			ctx.src_width = src->width;
+			ctx.src_height = src->height;
+			ctx.src_format = src->format;
+			ctx.dst_width = w;
+			ctx.dst_height = h;
+		}
+
+		ctx.thumb->width = ctx.dst_width;
+		ctx.thumb->height = ctx.dst_height;
+		ctx.thumb->format = _opts.format;
+		ctx.scaler->scale_frame(ctx.thumb, src);
+		ctx.thumb->pts = src->best_effort_timestamp;
+		return ctx.thumb;
+	}
+};
+
+} // namespace av
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Error.hpp"
+#include "IOContext.hpp"
+
+namespace av
+{
+
+/**
+ * `IOContext` over a local file, backed by io_uring so that file I/O overlaps
+ * with demuxing, decoding and encoding instead of blocking them.
+ *
+ * In `READ` mode, `queue_depth` blocks ahead of the current position are kept
+ * in flight; seeking outside the current block drops them and restarts the
+ * read-ahead at the new position. In `WRITE` mode, data is gathered into
+ * blocks that are submitted as they fill up, so `write()` only waits when all
+ * blocks are in flight; queued writes are completed before seeking, by
+ * `sync()` (called by `MediaWriter::write_trailer()`) and on destruction.
+ * Errors are only reported by `sync()`, so call it, directly or through
+ * `write_trailer()`, before destroying a writing context.
+ * @note Linux only. Requires liburing (enable `LIBAVPP_WITH_IO_URING` in
+ * CMake).
+ */
+class UringIOContext : public IOContext
+{
+public:
+	enum class Mode
+	{
+		READ,
+		WRITE,
+	};
+
+	struct Options
+	{
+		// number of blocks, and of requests kept in flight
+		unsigned queue_depth = 8;
+		// size of each read or write request
+		int block_size = 1 << 20;
+		// size of the `AVIOContext` buffer in front of the blocks
+		int buffer_size = 32768;
+	};
+
+private:
+	struct Block
+	{
+		std::unique_ptr<uint8_t[]> data;
+		// file offset of `data[0]`
+		int64_t offset{};
+		// bytes filled (write) or requested (read)
+		int len{};
+		// bytes completed so far, when resubmitting after a short transfer
+		int filled{};
+		// completion result: bytes transferred or a negative `AVERROR`
+		int result{};
+		bool pending{};
+	};
+
+	const Mode _mode;
+	const int _block_size;
+	int _fd{-1};
+	io_uring _ring{};
+	bool _ring_init{};
+	std::vector<Block> _blocks;
+	// read: block containing `_pos`; write: block being filled
+	size_t _cur{};
+	int64_t _pos{};
+	// read: file size; write: end of the data submitted so far
+	int64_t _size{};
+	// read: offset of the next read-ahead request
+	int64_t _ahead{};
+	// write: first failed write, reported by every later call
+	int _error{};
+
+public:
+	/**
+	 * Open the file at `path`; in `WRITE` mode it is created or truncated.
+	 * @throws `av::Error` if the options are invalid, the file cannot be
+	 * opened or the ring cannot be set up
+	 */
+	UringIOContext(const char *const path, const Mode mode, const Options &opts)
+		: IOContext{opts.buffer_size, mode == Mode::WRITE},
+		  _mode{mode},
+		  _block_size{opts.block_size},
+		  _blocks(opts.queue_depth)
+	{
+		if (!opts.queue_depth || opts.block_size <= 0)
+			throw Error("UringIOContext", AVERROR(EINVAL));
+		try
+		{
+			const int flags = mode == Mode::READ
+								  ? O_RDONLY | O_CLOEXEC
+								  : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+			if ((_fd = ::open(path, flags, 0666)) < 0)
+				throw Error("open", AVERROR(errno));
+
+			if (mode == Mode::READ)
+			{
+				struct stat st;
+				if (::fstat(_fd, &st) < 0)
+					throw Error("fstat", AVERROR(errno));
+				_size = st.st_size;
+			}
+
+			if (const auto rc =
+					io_uring_queue_init(opts.queue_depth, &_ring, 0);
+				rc < 0)
+				throw Error("io_uring_queue_init", rc);
+			_ring_init = true;
+
+			for (auto &b : _blocks)
+				b.data = std::make_unique_for_overwrite<uint8_t[]>(_block_size);
+			if (mode == Mode::READ)
+				start_reads(0);
+		}
+		catch (...)
+		{
+			release();
+			throw;
+		}
+	}
+
+	UringIOContext(const char *const path, const Mode mode)
+		: UringIOContext{path, mode, Options{}}
+	{
+	}
+
+	/**
+	 * Any write error not yet reported by `sync()` is lost.
+	 */
+	~UringIOContext()
+	{
+		if (_mode == Mode::WRITE)
+		{
+			flush();
+			submit_current();
+		}
+		// the kernel may still be writing into our blocks
+		drain();
+		release();
+	}
+
+	/**
+	 * In `WRITE` mode, submit the data written so far and wait for it to
+	 * reach the file.
+	 * @throws `av::Error` if any write failed
+	 */
+	void sync() override
+	{
+		IOContext::sync();
+		if (_mode != Mode::WRITE)
+			return;
+		if (const auto rc = submit_current(); rc < 0)
+			throw Error("UringIOContext::sync", rc);
+		if (const auto rc = drain(); rc < 0)
+			throw Error("UringIOContext::sync", _error = rc);
+	}
+
+	int read(uint8_t *const buf, const int size) override
+	{
+		if (_mode != Mode::READ)
+			return AVERROR(EINVAL);
+		if (_pos >= _size)
+			return AVERROR_EOF;
+
+		auto &b = _blocks[_cur];
+		if (const auto rc = wait(b); rc < 0)
+			return rc;
+		const auto off = _pos - b.offset;
+		const int n = std::min<int64_t>(size, b.result - off);
+		if (n <= 0)
+			// past the end of the file
+			return AVERROR_EOF;
+
+		std::memcpy(buf, b.data.get() + off, n);
+		_pos += n;
+		if (off + n == b.result)
+		{
+			// block consumed, reuse it further ahead
+			submit_read(b);
+			_cur = (_cur + 1) % _blocks.size();
+		}
+		return n;
+	}
+
+	int write(const uint8_t *const buf, const int size) override
+	{
+		if (_mode != Mode::WRITE)
+			return AVERROR(EINVAL);
+		if (_error)
+			return _error;
+
+		for (int done = 0; done < size;)
+		{
+			auto &b = _blocks[_cur];
+			const int n = std::min(size - done, _block_size - b.len);
+			std::memcpy(b.data.get() + b.len, buf + done, n);
+			b.len += n;
+			done += n;
+			if (b.len == _block_size)
+				if (const auto rc = submit_current(); rc < 0)
+					return rc;
+		}
+		_pos += size;
+		return size;
+	}
+
+	int64_t seek(int64_t offset, const int whence) override
+	{
+		switch (whence & ~AVSEEK_FORCE)
+		{
+		case AVSEEK_SIZE:
+			return size();
+		case SEEK_SET:
+			break;
+		case SEEK_CUR:
+			offset += _pos;
+			break;
+		case SEEK_END:
+			offset += size();
+			break;
+		default:
+			return AVERROR(EINVAL);
+		}
+		if (offset < 0)
+			return AVERROR(EINVAL);
+		return _mode == Mode::READ ? seek_read(offset) : seek_write(offset);
+	}
+
+private:
+	int64_t size() const
+	{
+		if (_mode == Mode::READ)
+			return _size;
+		const auto &b = _blocks[_cur];
+		return std::max(_size, b.offset + b.len);
+	}
+
+	void start_reads(const int64_t pos)
+	{
+		_pos = _ahead = pos;
+		_cur = 0;
+		for (auto &b : _blocks)
+			submit_read(b);
+	}
+
+	int64_t seek_read(const int64_t pos)
+	{
+		// stay in the current block without disturbing the read-ahead
+		if (const auto &b = _blocks[_cur];
+			pos >= b.offset && pos < b.offset + _block_size)
+		{
+			_pos = pos;
+			return pos;
+		}
+		if (const auto rc = drain(); rc < 0)
+			return rc;
+		start_reads(pos);
+		return pos;
+	}
+
+	int64_t seek_write(const int64_t pos)
+	{
+		if (const auto rc = submit_current(); rc < 0)
+			return rc;
+		if (const auto rc = drain(); rc < 0)
+			return _error = rc;
+		auto &b = _blocks[_cur];
+		b.offset = _pos = pos;
+		b.len = 0;
+		return pos;
+	}
+
+	void submit_read(Block &b)
+	{
+		b.offset = _ahead;
+		b.len =
+			static_cast<int>(std::min<int64_t>(_block_size, _size - _ahead));
+		b.filled = 0;
+		_ahead += _block_size;
+		if (b.len <= 0)
+		{
+			// past the end of the file
+			b.len = b.result = 0;
+			return;
+		}
+		submit(b, io_uring_get_sqe(&_ring));
+	}
+
+	/**
+	 * Submit the block being filled, if it has data, and make the next one
+	 * available for filling.
+	 */
+	int submit_current()
+	{
+		if (_error)
+			return _error;
+		auto &b = _blocks[_cur];
+		if (!b.len)
+			return 0;
+		b.filled = 0;
+		submit(b, io_uring_get_sqe(&_ring));
+		_size = std::max(_size, b.offset + b.len);
+
+		const auto next_offset = b.offset + b.len;
+		_cur = (_cur + 1) % _blocks.size();
+		auto &next = _blocks[_cur];
+		if (const auto rc = wait(next); rc < 0)
+			return _error = rc;
+		next.offset = next_offset;
+		next.len = 0;
+		return 0;
+	}
+
+	void submit(Block &b, io_uring_sqe *const sqe)
+	{
+		// every block has its own submission slot, so `sqe` is never `NULL`
+		if (_mode == Mode::READ)
+			io_uring_prep_read(
+				sqe,
+				_fd,
+				b.data.get() + b.filled,
+				b.len - b.filled,
+				b.offset + b.filled);
+		else
+			io_uring_prep_write(
+				sqe,
+				_fd,
+				b.data.get() + b.filled,
+				b.len - b.filled,
+				b.offset + b.filled);
+		io_uring_sqe_set_data(sqe, &b);
+		b.pending = true;
+		if (const auto rc = io_uring_submit(&_ring); rc < 0)
+		{
+			b.pending = false;
+			b.result = rc;
+		}
+	}
+
+	/**
+	 * Wait for the request of `b` to complete. Short reads and writes are
+	 * resubmitted for the remainder of the block, so a completed request
+	 * always has `result == len`.
+	 * @return `0`, or a negative `AVERROR` code if the request failed.
+	 */
+	int wait(Block &b)
+	{
+		while (b.pending)
+		{
+			io_uring_cqe *cqe;
+			if (const auto rc = io_uring_wait_cqe(&_ring, &cqe); rc < 0)
+			{
+				if (rc == -EINTR)
+					continue;
+				return rc;
+			}
+			const auto done = static_cast<Block *>(io_uring_cqe_get_data(cqe));
+			const auto res = cqe->res;
+			io_uring_cqe_seen(&_ring, cqe);
+			done->pending = false;
+			if (res >= 0)
+			{
+				done->filled += res;
+				if (!res)
+				{
+					// no progress: the file was truncated while reading, or
+					// the write can't proceed
+					done->result = AVERROR(EIO);
+					continue;
+				}
+				if (done->filled < done->len)
+				{
+					submit(*done, io_uring_get_sqe(&_ring));
+					continue;
+				}
+				done->result = done->filled;
+			}
+			else
+				done->result = res;
+		}
+		return b.result < 0 ? b.result : 0;
+	}
+
+	/**
+	 * Wait for every request in flight.
+	 * @return The first error among them, or `0`.
+	 */
+	int drain()
+	{
+		int err{};
+		if (!_ring_init)
+			return err;
+		for (auto &b : _blocks)
+			if (const auto rc = wait(b); rc < 0 && !err)
+				err = rc;
+		return err;
+	}
+
+	void release()
+	{
+		if (_ring_init)
+			io_uring_queue_exit(&_ring);
+		_ring_init = false;
+		if (_fd >= 0)
+			::close(_fd);
+		_fd = -1;
+	}
+};
+
+} // namespace av
@@ -0,0 +1,78 @@
+#pragma once
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+#include "Error.hpp"
+#include "IOContext.hpp"
+
+namespace av
+{
+
+/**
+ * `IOContext` over any URL FFmpeg's protocols can open (files, HTTP, ...),
+ * through `avio_open2`. Useful to put a URL behind an `IOContext` decorator
+ * such as `InstrumentedIOContext`; otherwise, opening the URL directly with
+ * `MediaReader`/`MediaWriter` avoids a second buffer.
+ */
+class UrlIOContext : public IOContext
+{
+	AVIOContext *_url{};
+
+public:
+	/**
+	 * @param flags `AVIO_FLAG_READ` and/or `AVIO_FLAG_WRITE`.
+	 * @param options Protocol-private options, may be `NULL`. On return,
+	 * filled with the options that were not found.
+	 * @throws `av::Error` if `avio_open2` fails
+	 */
+	UrlIOContext(
+		const char *const url,
+		const int flags = AVIO_FLAG_READ,
+		AVDictionary **const options = NULL,
+		const int buffer_size = 32768)
+		: IOContext{buffer_size, (flags & AVIO_FLAG_WRITE) != 0}
+	{
+		if (const auto rc = avio_open2(&_url, url, flags, NULL, options);
+			rc < 0)
+			throw Error("avio_open2", rc);
+	}
+
+	~UrlIOContext()
+	{
+		if (_ioctx->write_flag)
+			flush();
+		avio_closep(&_url);
+	}
+
+	void sync() override
+	{
+		IOContext::sync();
+		avio_flush(_url);
+		if (_url->error < 0)
+			throw Error("avio_flush", _url->error);
+	}
+
+	int read(uint8_t *const buf, const int size) override
+	{
+		const auto rc = avio_read_partial(_url, buf, size);
+		return rc ? rc : AVERROR_EOF;
+	}
+
+	int write(const uint8_t *const buf, const int size) override
+	{
+		avio_write(_url, buf, size);
+		return _url->error < 0 ? _url->error : size;
+	}
+
+	int64_t seek(const int64_t offset, const int whence) override
+	{
+		if (whence & AVSEEK_SIZE)
+			return avio_size(_url);
+		return avio_seek(_url, offset, whence);
+	}
+};
+
+} // namespace av
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+
 extern "C"
 {
 #include <libavcodec/avcodec.h>
 #include <libavfilter/avfilter.h>
+#include <libavformat/avformat.h>
 #include <libavutil/avutil.h>
+#include <libavutil/imgutils.h>
 }
 
 #include "Error.hpp"
@@ -19,6 +25,13 @@ inline const AVCodec *find_encoder_by_name(const char *const name)
 	throw Error("avcodec_find_encoder_by_name", AVERROR_ENCODER_NOT_FOUND);
 }
 
+inline const AVInputFormat *find_input_format(const char *const short_name)
+{
+	if (const auto fmt = av_find_input_format(short_name))
+		return fmt;
+	throw Error("av_find_input_format", AVERROR_DEMUXER_NOT_FOUND);
+}
+
 inline const AVFilter *get_filter_by_name(const char *const name)
 {
 	if (const auto filter = avfilter_get_by_name(name))
@@ -26,6 +39,65 @@ inline const AVFilter *get_filter_by_name(const char *const name)
 	throw Error("avfilter_get_by_name", AVERROR_FILTER_NOT_FOUND);
 }
 
+/**
+ * Validate the alignment of custom frame buffers (`FrameAllocator`,
+ * `FramePool`).
+ * @return `align`, raised to 64 (the widest SIMD alignment FFmpeg uses) if
+ * smaller.
+ * @throws `av::Error` with `AVERROR(EINVAL)` if `align` is not a power of two
+ */
+inline size_t buffer_alignment(const size_t align)
+{
+	if (!std::has_single_bit(align))
+		throw Error("buffer_alignment", AVERROR(EINVAL));
+	return std::max<size_t>(align, 64);
+}
+
+/**
+ * Compute the plane layout of a `format` image for custom frame buffers. Like
+ * FFmpeg's default allocator, the image is widened until every line size is a
+ * multiple of both `align` and `linesize_align[i]` (if given), which keeps the
+ * chroma line sizes consistent with the luma one.
+ * @param sizes Receives the size of each plane, plus padding that decoders and
+ * SIMD code may read past its end; `0` for unused planes.
+ * @return `0`, or a negative `AVERROR` code.
+ */
+inline int image_plane_layout(
+	int linesize[4],
+	size_t sizes[4],
+	const AVPixelFormat format,
+	int width,
+	const int height,
+	const size_t align,
+	const int *const linesize_align = NULL)
+{
+	while (true)
+	{
+		if (const auto rc = av_image_fill_linesizes(linesize, format, width);
+			rc < 0)
+			return rc;
+		bool aligned = true;
+		for (int i = 0; i < 4; ++i)
+			if (linesize[i] %
+				std::max<int>(align, linesize_align ? linesize_align[i] : 1))
+				aligned = false;
+		if (aligned)
+			break;
+		width += width & ~(width - 1);
+	}
+
+	const ptrdiff_t linesize_p[4] = {
+		linesize[0], linesize[1], linesize[2], linesize[3]};
+	if (const auto rc =
+			av_image_fill_plane_sizes(sizes, format, height, linesize_p);
+		rc < 0)
+		return rc;
+	for (int i = 0; i < 4; ++i)
+		if (sizes[i])
+			sizes[i] += 16;
+	return 0;
+}
+
 /**
  * A range-based for loop compatible wrapper for `av_hwdevice_iterate_types`.
  *
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <climits>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "Error.hpp"
+#include "Frame.hpp"
+#include "PlaneView.hpp"
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+namespace av
+{
+
+/**
+ * `Frame` statically known to be in the pixel format `Fmt`. Its plane count,
+ * chroma subsampling and element types are compile-time constants (from
+ * `PixelTraits`), so code written against it needs no pixel format
+ * descriptor lookups or per-format branches, and loops over its planes are
+ * unrolled. Non-owning, like `Frame`.
+ */
+template <AVPixelFormat Fmt>
+class VideoFrame : public Frame
+{
+public:
+	using traits = PixelTraits<Fmt>;
+
+	template <size_t I>
+	using plane_type = std::tuple_element_t<I, typename traits::planes>;
+
+	static constexpr AVPixelFormat format = Fmt;
+	static constexpr size_t nb_planes = traits::nb_planes;
+	static constexpr int log2_chroma_w = traits::log2_chroma_w;
+	static constexpr int log2_chroma_h = traits::log2_chroma_h;
+
+	/**
+	 * Checked conversion from a dynamically typed frame.
+	 * @throws `av::Error` if `f` is `NULL` or not in the format `Fmt`
+	 */
+	explicit VideoFrame(AVFrame *const f)
+		: Frame{f}
+	{
+		if (!matches(f))
+			throw Error("VideoFrame", AVERROR(EINVAL));
+	}
+
+	/**
+	 * Non-throwing checked conversion.
+	 * @return The typed frame, or `AVERROR(EINVAL)` if `f` is `NULL` or not
+	 * in the format `Fmt`.
+	 */
+	static Expected<VideoFrame> try_from(AVFrame *const f)
+	{
+		if (!matches(f))
+			return std::unexpected{AVERROR(EINVAL)};
+		return VideoFrame{f};
+	}
+
+	static bool matches(const AVFrame *const f)
+	{
+		return f && f->format == Fmt;
+	}
+
+	int width() const { return _f->width; }
+	int height() const { return _f->height; }
+
+	template <size_t I>
+	int plane_width() const
+	{
+		return traits::plane_width(I, _f->width);
+	}
+
+	template <size_t I>
+	int plane_height() const
+	{
+		return traits::plane_height(I, _f->height);
+	}
+
+	/**
+	 * @return A typed view of plane `I`.
+	 */
+	template <size_t I>
+		requires(I < nb_planes)
+	PlaneView<plane_type<I>> plane() const
+	{
+		return {
+			reinterpret_cast<plane_type<I> *>(_f->data[I]),
+			static_cast<size_t>(plane_width<I>()),
+			static_cast<size_t>(plane_height<I>()),
+			_f->linesize[I]};
+	}
+
+	/**
+	 * Call `f(plane<I>())` for every plane, in order.
+	 */
+	template <typename F>
+	void for_each_plane(F &&f) const
+	{
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			(f(plane<I>()), ...);
+		}(std::make_index_sequence<nb_planes>{});
+	}
+
+	/**
+	 * Same as `Frame::image_get_buffer_size`, without looking up the pixel
+	 * format.
+	 * @throws `av::Error` if the size does not fit in an `int`
+	 */
+	int image_get_buffer_size(const int align = 1) const
+	{
+		size_t size = 0;
+		for_each_plane(
+			[&](const auto &plane)
+			{
+				size += aligned_row_size(plane, align) * plane.height();
+			});
+		if (size > INT_MAX)
+			throw Error("VideoFrame::image_get_buffer_size", AVERROR(EINVAL));
+		return static_cast<int>(size);
+	}
+
+	/**
+	 * Same as `Frame::image_copy_to_buffer`, without looking up the pixel
+	 * format.
+	 * @throws `av::Error` if `dst_size` is too small, or the size does not fit
+	 * in an `int`
+	 */
+	void image_copy_to_buffer(
+		uint8_t *dst, const int dst_size, const int align = 1) const
+	{
+		if (dst_size < image_get_buffer_size(align))
+			throw Error("VideoFrame::image_copy_to_buffer", AVERROR(EINVAL));
+		for_each_plane(
+			[&](const auto &plane)
+			{
+				const auto row_size = aligned_row_size(plane, align);
+				for (size_t y = 0; y < plane.height(); ++y, dst += row_size)
+					std::memcpy(
+						dst,
+						plane.row(y).data(),
+						plane.width() * sizeof(*plane.data()));
+			});
+	}
+
+private:
+	template <typename T>
+	static size_t aligned_row_size(const PlaneView<T> &plane, const int align)
+	{
+		const size_t a = align > 0 ? align : 1;
+		return (plane.width() * sizeof(T) + a - 1) / a * a;
+	}
+};
+
+} // namespace av